@@ -0,0 +1,110 @@
+#include "radix_sort.h"
+
+typedef struct {
+    int studID;
+    char fname[20];
+    char lname[20];
+} Student;
+
+typedef struct {
+    char code[8];
+    double cost;
+} Flight;
+
+typedef struct {
+    int duration; // Seconds the lane is active
+    char lane[5];
+} Traffic;
+
+typedef struct {
+    int prodID;
+    char name[20];
+    int stock;
+} Product;
+
+const char *studentLname(const void *s, size_t *len) {
+    *len = strlen(((const Student*) s)->lname);
+    return ((const Student*) s)->lname;
+}
+
+uint32_t productID(const void *p) {
+    return intKey32(((const Product*) p)->prodID);
+}
+
+#define FLIGHT_COST(f) doubleKey((f)->cost)
+DEFINE_RADIX_SORT(sortFlights, Flight, FLIGHT_COST)
+
+#define TRAFFIC_DURATION(t) intKey32((t)->duration)
+DEFINE_RADIX_SORT32(sortTraffic, Traffic, TRAFFIC_DURATION)
+
+/*Prints why a sort failed and returns the exit code for it.*/
+int sortFailed(RadixStatus status) {
+    if (status == RADIX_TOO_MANY) {
+        printf("Too many records to sort.\n");
+    } else {
+        printf("Memory allocation failed.\n");
+    }
+    return 1;
+}
+
+int main() {
+    Student students[] = {
+        {1001, "Maria", "Santos"}, {1002, "Jose", "Reyes"}, {1003, "Ana", "Cruz"},
+        {1004, "Juan", "Santos"}, {1005, "Liza", "Bautista"}, {1006, "Mark", "Reyes"}
+    };
+    Flight flights[] = {
+        {"PR 102", 349.99}, {"5J 560", 89.50}, {"Z2 211", 120.00},
+        {"PR 300", 1249.00}, {"DG 74", 0.00}, {"5J 911", -15.25} // A voucher refund
+    };
+    Traffic traffic[] = {
+        {45, "main"}, {30, "alt"}, {90, "main"}, {30, "main"}, {15, "alt"}, {45, "alt"}
+    };
+    Product products[] = {
+        {305, "Stapler", 12}, {-1, "Sample", 3}, {12, "Ballpen", 240},
+        {7, "Notebook", 85}, {1200, "Printer", 2}, {98, "Folder", 60}
+    };
+    int students_count = sizeof(students) / sizeof(students[0]),
+    flights_count = sizeof(flights) / sizeof(flights[0]),
+    traffic_count = sizeof(traffic) / sizeof(traffic[0]),
+    products_count = sizeof(products) / sizeof(products[0]),
+    i;
+    RadixStatus status;
+
+    status = radixSortStrings(students, students_count, sizeof(Student), studentLname);
+    if (status != RADIX_OK) {
+        return sortFailed(status);
+    }
+    printf("Students by last name:\n");
+    for (i = 0; i < students_count; i++) {
+        printf("%d; %s %s\n", students[i].studID, students[i].fname, students[i].lname);
+    }
+
+    status = sortFlights(flights, flights_count);
+    if (status != RADIX_OK) {
+        return sortFailed(status);
+    }
+    printf("\nFlights by cost:\n");
+    for (i = 0; i < flights_count; i++) {
+        printf("%s; %.2f\n", flights[i].code, flights[i].cost);
+    }
+
+    status = sortTraffic(traffic, traffic_count);
+    if (status != RADIX_OK) {
+        return sortFailed(status);
+    }
+    printf("\nLanes by duration:\n");
+    for (i = 0; i < traffic_count; i++) {
+        printf("%s; %d seconds\n", traffic[i].lane, traffic[i].duration);
+    }
+
+    status = radixSort32(products, products_count, sizeof(Product), productID);
+    if (status != RADIX_OK) {
+        return sortFailed(status);
+    }
+    printf("\nProducts by ID:\n");
+    for (i = 0; i < products_count; i++) {
+        printf("%d; %s; %d in stock\n", products[i].prodID, products[i].name, products[i].stock);
+    }
+
+    return 0;
+}
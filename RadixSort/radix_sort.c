@@ -0,0 +1,281 @@
+#include "radix_sort.h"
+
+#define BUCKETS 257 // A bucket for each byte and one for the end of a string
+#define INSERTION_THRESHOLD 16
+
+// Bucket of a string key at position d; 0 is the end of the string
+#define BUCKET_AT(p, d) ((d) < (p).len ? (unsigned char)(p).str[(d)] + 1 : 0)
+
+static void msdSort(StringIndex *pairs, StringIndex *scratch, size_t count, size_t depth);
+static void insertionSort(StringIndex *pairs, size_t count, size_t depth);
+static RadixStatus gather(void *base, size_t count, size_t size, const void *pairs, size_t stride);
+static RadixStatus gather32(void *base, size_t count, size_t size, const uint64_t *pairs);
+static RadixStatus sortRecords32(void *base, size_t count, size_t size, IntKey32 key);
+
+/*Sorts count records of size bytes at base by their integer keys.*/
+RadixStatus radixSort(void *base, size_t count, size_t size, IntKey key) {
+    if (count < 2) return RADIX_OK;
+    KeyIndex *pairs = (KeyIndex*) malloc (sizeof(KeyIndex) * count);
+    if (!pairs) return RADIX_NO_MEMORY;
+    for (size_t i = 0; i < count; i++) {
+        pairs[i].key = key((char*) base + i * size);
+        pairs[i].idx = i;
+    }
+    RadixStatus status = sortKeys(pairs, count);
+    if (status == RADIX_OK) status = gather(base, count, size, &pairs[0].idx, sizeof(KeyIndex));
+    free(pairs);
+    return status;
+}
+
+/*Sorts count records of size bytes at base by their string keys, byte by
+  byte, a shorter key first when it is the start of a longer one.*/
+RadixStatus radixSortStrings(void *base, size_t count, size_t size, StringKey key) {
+    if (count < 2) return RADIX_OK;
+    StringIndex *pairs = (StringIndex*) malloc (sizeof(StringIndex) * count);
+    if (!pairs) return RADIX_NO_MEMORY;
+    for (size_t i = 0; i < count; i++) {
+        pairs[i].str = key((char*) base + i * size, &pairs[i].len);
+        pairs[i].idx = i;
+    }
+    RadixStatus status = sortStringKeys(pairs, count);
+    if (status == RADIX_OK) status = gather(base, count, size, &pairs[0].idx, sizeof(StringIndex));
+    free(pairs);
+    return status;
+}
+
+/*Sorts count records of size bytes at base by their 32-bit integer keys.*/
+RadixStatus radixSort32(void *base, size_t count, size_t size, IntKey32 key) {
+    if (count < 2) return RADIX_OK;
+    if (count > UINT32_MAX) return RADIX_TOO_MANY;
+    if (size <= RECORD_DIRECT_MAX) return sortRecords32(base, count, size, key);
+    uint64_t *pairs = (uint64_t*) malloc (sizeof(uint64_t) * count);
+    if (!pairs) return RADIX_NO_MEMORY;
+    for (size_t i = 0; i < count; i++) {
+        pairs[i] = keyIndex32(key((char*) base + i * size), (uint32_t) i);
+    }
+    RadixStatus status = sortKeys32(pairs, count);
+    if (status == RADIX_OK) status = gather32(base, count, size, pairs);
+    free(pairs);
+    return status;
+}
+
+/*LSD radix sort on the keys a byte at a time. The histograms of all eight
+  bytes are counted in one pass, and bytes that are the same in every key
+  are skipped, so small keys only take as many passes as they have bytes.*/
+RadixStatus sortKeys(KeyIndex *pairs, size_t count) {
+    size_t hist[8][256] = {{0}}, i, total, c;
+    int k, b;
+    if (count < 2) return RADIX_OK;
+    KeyIndex *src = pairs, *dst = (KeyIndex*) malloc (sizeof(KeyIndex) * count), *temp;
+    if (!dst) return RADIX_NO_MEMORY;
+
+    for (i = 0; i < count; i++) {
+        for (k = 0; k < 8; k++) {
+            hist[k][(pairs[i].key >> (8 * k)) & 0xFF]++;
+        }
+    }
+
+    for (k = 0; k < 8; k++) {
+        if (hist[k][(src[0].key >> (8 * k)) & 0xFF] == count) continue; // Same byte in every key
+        for (b = 0, total = 0; b < 256; b++) {
+            c = hist[k][b];
+            hist[k][b] = total;
+            total += c;
+        }
+        for (i = 0; i < count; i++) {
+            dst[hist[k][(src[i].key >> (8 * k)) & 0xFF]++] = src[i];
+        }
+        temp = src;
+        src = dst;
+        dst = temp;
+    }
+
+    if (src != pairs) { // An odd number of passes leaves the keys in the scratch array
+        memcpy(pairs, src, sizeof(KeyIndex) * count);
+        dst = src;
+    }
+    free(dst);
+    return RADIX_OK;
+}
+
+/*Like sortKeys, on the key half of packed pairs only. The index half
+  starts in order and is never sorted on, so equal keys stay in order.*/
+RadixStatus sortKeys32(uint64_t *pairs, size_t count) {
+    size_t hist[4][256] = {{0}}, i, total, c;
+    int k, b;
+    if (count < 2) return RADIX_OK;
+    uint64_t *src = pairs, *dst = (uint64_t*) malloc (sizeof(uint64_t) * count), *temp;
+    if (!dst) return RADIX_NO_MEMORY;
+
+    for (i = 0; i < count; i++) {
+        for (k = 0; k < 4; k++) {
+            hist[k][(pairs[i] >> (32 + 8 * k)) & 0xFF]++;
+        }
+    }
+
+    for (k = 0; k < 4; k++) {
+        if (hist[k][(src[0] >> (32 + 8 * k)) & 0xFF] == count) continue; // Same byte in every key
+        for (b = 0, total = 0; b < 256; b++) {
+            c = hist[k][b];
+            hist[k][b] = total;
+            total += c;
+        }
+        for (i = 0; i < count; i++) {
+            dst[hist[k][(src[i] >> (32 + 8 * k)) & 0xFF]++] = src[i];
+        }
+        temp = src;
+        src = dst;
+        dst = temp;
+    }
+
+    if (src != pairs) {
+        memcpy(pairs, src, sizeof(uint64_t) * count);
+        dst = src;
+    }
+    free(dst);
+    return RADIX_OK;
+}
+
+/*MSD radix sort on the string keys. Every pass is a counting sort into a
+  scratch array, which keeps equal keys in order.*/
+RadixStatus sortStringKeys(StringIndex *pairs, size_t count) {
+    if (count < 2) return RADIX_OK;
+    StringIndex *scratch = (StringIndex*) malloc (sizeof(StringIndex) * count);
+    if (!scratch) return RADIX_NO_MEMORY;
+    msdSort(pairs, scratch, count, 0);
+    free(scratch);
+    return RADIX_OK;
+}
+
+static void msdSort(StringIndex *pairs, StringIndex *scratch, size_t count, size_t depth) {
+    size_t hist[BUCKETS], start[BUCKETS], i, total;
+    int b, largest;
+    while (count >= INSERTION_THRESHOLD) {
+        for (;;) { // Skip positions where every key has the same byte
+            memset(hist, 0, sizeof(hist));
+            for (i = 0; i < count; i++) {
+                hist[BUCKET_AT(pairs[i], depth)]++;
+            }
+            b = BUCKET_AT(pairs[0], depth);
+            if (hist[b] != count) break;
+            if (b == 0) return; // Every key has ended, so they are all equal
+            depth++;
+        }
+
+        for (b = 0, total = 0; b < BUCKETS; b++) {
+            start[b] = total;
+            total += hist[b];
+        }
+        for (i = 0; i < count; i++) {
+            scratch[start[BUCKET_AT(pairs[i], depth)]++] = pairs[i];
+        }
+        memcpy(pairs, scratch, sizeof(StringIndex) * count);
+
+        // Bucket 0 holds keys that have ended, which are all equal. Only the
+        // smaller buckets are sorted by recursion and the largest by the loop,
+        // so the stack stays within log2(count) frames.
+        for (largest = 1, b = 2; b < BUCKETS; b++) {
+            if (hist[b] > hist[largest]) largest = b;
+        }
+        for (b = 1; b < BUCKETS; b++) {
+            if (b != largest && hist[b] > 1) {
+                msdSort(pairs + start[b] - hist[b], scratch, hist[b], depth + 1);
+            }
+        }
+        pairs += start[largest] - hist[largest];
+        count = hist[largest];
+        depth++;
+    }
+    insertionSort(pairs, count, depth);
+}
+
+static void insertionSort(StringIndex *pairs, size_t count, size_t depth) {
+    size_t i, j, len;
+    StringIndex p;
+    int cmp;
+    for (i = 1; i < count; i++) {
+        p = pairs[i];
+        for (j = i; j > 0; j--) {
+            len = p.len < pairs[j - 1].len ? p.len : pairs[j - 1].len;
+            cmp = len > depth ? memcmp(p.str + depth, pairs[j - 1].str + depth, len - depth) : 0;
+            if (cmp > 0 || (cmp == 0 && p.len >= pairs[j - 1].len)) break;
+            pairs[j] = pairs[j - 1];
+        }
+        pairs[j] = p;
+    }
+}
+
+/*Moves the records into the order given by the record indices in pairs,
+  which are stride bytes apart.*/
+static RadixStatus gather(void *base, size_t count, size_t size, const void *pairs, size_t stride) {
+    char *temp = (char*) malloc (size * count);
+    if (!temp) return RADIX_NO_MEMORY;
+    for (size_t i = 0; i < count; i++) {
+        memcpy(temp + i * size, (char*) base + *(const size_t*) ((const char*) pairs + i * stride) * size, size);
+    }
+    memcpy(base, temp, size * count);
+    free(temp);
+    return RADIX_OK;
+}
+
+/*Like gather, for packed pairs from sortKeys32.*/
+static RadixStatus gather32(void *base, size_t count, size_t size, const uint64_t *pairs) {
+    char *temp = (char*) malloc (size * count);
+    if (!temp) return RADIX_NO_MEMORY;
+    for (size_t i = 0; i < count; i++) {
+        memcpy(temp + i * size, (char*) base + (uint32_t) pairs[i] * size, size);
+    }
+    memcpy(base, temp, size * count);
+    free(temp);
+    return RADIX_OK;
+}
+
+/*LSD radix sort for small records, which moves each record with its key on
+  every pass rather than gathering them through indices at the end. The
+  keys are worked out once, into an array that is sorted alongside.*/
+static RadixStatus sortRecords32(void *base, size_t count, size_t size, IntKey32 key) {
+    size_t hist[4][256] = {{0}}, i, total, c, pos;
+    int k, b;
+    uint32_t *keys = (uint32_t*) malloc (sizeof(uint32_t) * count * 2), *keySrc = keys, *keyDst = keys + count, *keyTemp;
+    char *src = (char*) base, *dst = (char*) malloc (size * count), *temp;
+    if (!keys || !dst) {
+        free(keys);
+        free(dst);
+        return RADIX_NO_MEMORY;
+    }
+
+    for (i = 0; i < count; i++) {
+        keys[i] = key(src + i * size);
+        for (k = 0; k < 4; k++) {
+            hist[k][(keys[i] >> (8 * k)) & 0xFF]++;
+        }
+    }
+
+    for (k = 0; k < 4; k++) {
+        if (hist[k][(keySrc[0] >> (8 * k)) & 0xFF] == count) continue; // Same byte in every key
+        for (b = 0, total = 0; b < 256; b++) {
+            c = hist[k][b];
+            hist[k][b] = total;
+            total += c;
+        }
+        for (i = 0; i < count; i++) {
+            pos = hist[k][(keySrc[i] >> (8 * k)) & 0xFF]++;
+            keyDst[pos] = keySrc[i];
+            memcpy(dst + pos * size, src + i * size, size);
+        }
+        keyTemp = keySrc;
+        keySrc = keyDst;
+        keyDst = keyTemp;
+        temp = src;
+        src = dst;
+        dst = temp;
+    }
+
+    if (src != (char*) base) {
+        memcpy(base, src, size * count);
+        dst = src;
+    }
+    free(keys);
+    free(dst);
+    return RADIX_OK;
+}
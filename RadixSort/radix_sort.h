@@ -0,0 +1,222 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/*Radix sorts for arrays of any record type. Each record is given a key,
+  either an unsigned integer or a string of bytes, and the records are put
+  in order of their keys, smallest first. Equal keys keep their order.
+
+  The keys are worked out once per record and sorted next to the index of
+  their record, then the records are moved into place in a single pass, so
+  large records are only copied twice however many passes the sort takes.
+
+  Keys of 32 bits or less have their own sorts, radixSort32 and
+  DEFINE_RADIX_SORT32, which pack each key and a 32-bit record index into
+  one 64-bit pair and only sort on the key half, so they take at most four
+  passes over half as much memory. Records of RECORD_DIRECT_MAX bytes or
+  less are not worth sorting through indices, and are moved directly on
+  every pass instead.*/
+
+#define RECORD_DIRECT_MAX 16 // Largest record the 32-bit sorts move directly
+
+/*Returns the integer key of a record. Use the *Key helpers below to turn
+  signed numbers into keys that sort in the right order.*/
+typedef uint64_t (*IntKey)(const void *record);
+
+/*Returns the 32-bit integer key of a record; see intKey32.*/
+typedef uint32_t (*IntKey32)(const void *record);
+
+/*Returns the string key of a record and sets len to its number of bytes.*/
+typedef const char *(*StringKey)(const void *record, size_t *len);
+
+typedef struct {
+    uint64_t key;
+    size_t idx; // Index of the record in the array
+} KeyIndex;
+
+typedef struct {
+    const char *str;
+    size_t len;
+    size_t idx;
+} StringIndex;
+
+/*What the sorts return. They print nothing, so reporting a failure is up
+  to the caller; the records are left as they were.*/
+typedef enum {
+    RADIX_OK,
+    RADIX_NO_MEMORY, // Memory allocation failed
+    RADIX_TOO_MANY   // More than UINT32_MAX records for a 32-bit sort
+} RadixStatus;
+
+RadixStatus radixSort(void *base, size_t count, size_t size, IntKey key);
+RadixStatus radixSortStrings(void *base, size_t count, size_t size, StringKey key);
+RadixStatus radixSort32(void *base, size_t count, size_t size, IntKey32 key);
+
+/*The sorts behind radixSort and radixSortStrings, for keys that have
+  already been worked out.*/
+RadixStatus sortKeys(KeyIndex *pairs, size_t count);
+RadixStatus sortStringKeys(StringIndex *pairs, size_t count);
+
+/*Sorts pairs made by keyIndex32 by their keys, leaving the indices of
+  equal keys in order.*/
+RadixStatus sortKeys32(uint64_t *pairs, size_t count);
+
+/*Keys for signed numbers: flipping the sign bit puts negative numbers
+  before positive ones, and negative floating point numbers also have
+  their other bits flipped, as larger bits mean more negative.*/
+static inline uint64_t intKey(int64_t x) {
+    return (uint64_t) x ^ 0x8000000000000000ULL;
+}
+
+static inline uint32_t intKey32(int32_t x) {
+    return (uint32_t) x ^ 0x80000000U;
+}
+
+/*Packs a 32-bit key above the index of its record.*/
+static inline uint64_t keyIndex32(uint32_t key, uint32_t idx) {
+    return (uint64_t) key << 32 | idx;
+}
+
+static inline uint64_t doubleKey(double x) {
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return (bits >> 63) ? ~bits : bits | 0x8000000000000000ULL;
+}
+
+/*Defines RadixStatus name(type *arr, size_t count), a radix sort for
+  arrays of type. keyOf is a function or macro taking a const type * and
+  giving its integer key; it is expanded in place, and records are copied
+  as type instead of byte by byte.*/
+#define DEFINE_RADIX_SORT(name, type, keyOf)                                \
+RadixStatus name(type *arr, size_t count) {                                 \
+    KeyIndex *pairs;                                                        \
+    type *temp;                                                             \
+    size_t i;                                                               \
+    if (count < 2) return RADIX_OK;                                         \
+    pairs = (KeyIndex*) malloc (sizeof(KeyIndex) * count);                  \
+    temp = (type*) malloc (sizeof(type) * count);                           \
+    if (!pairs || !temp) {                                                  \
+        free(pairs);                                                        \
+        free(temp);                                                         \
+        return RADIX_NO_MEMORY;                                             \
+    }                                                                       \
+    for (i = 0; i < count; i++) {                                           \
+        pairs[i].key = keyOf(&arr[i]);                                      \
+        pairs[i].idx = i;                                                   \
+    }                                                                       \
+    RadixStatus status = sortKeys(pairs, count);                            \
+    if (status == RADIX_OK) {                                               \
+        for (i = 0; i < count; i++) temp[i] = arr[pairs[i].idx];            \
+        memcpy(arr, temp, sizeof(type) * count);                            \
+    }                                                                       \
+    free(pairs);                                                            \
+    free(temp);                                                             \
+    return status;                                                          \
+}
+
+/*Like DEFINE_RADIX_SORT, but keyOf gives a 32-bit key (see intKey32). A
+  type of RECORD_DIRECT_MAX bytes or less is sorted a key byte at a time
+  with the records themselves, each record's key worked out once and moved
+  along with it; larger types go through packed key and index pairs. At
+  most UINT32_MAX records can be sorted.*/
+#define DEFINE_RADIX_SORT32(name, type, keyOf)                              \
+RadixStatus name(type *arr, size_t count) {                                 \
+    size_t hist[4][256] = {{0}}, i, total, c, pos;                          \
+    uint64_t *pairs = NULL;                                                 \
+    uint32_t *keys = NULL, *keySrc, *keyDst, *keySwap;                      \
+    type *src = arr, *dst, *swap;                                           \
+    int d, b;                                                               \
+    if (count < 2) return RADIX_OK;                                         \
+    if (count > UINT32_MAX) return RADIX_TOO_MANY;                          \
+    dst = (type*) malloc (sizeof(type) * count);                            \
+    if (sizeof(type) > RECORD_DIRECT_MAX) {                                 \
+        pairs = (uint64_t*) malloc (sizeof(uint64_t) * count);              \
+    } else {                                                                \
+        keys = (uint32_t*) malloc (sizeof(uint32_t) * count * 2);           \
+    }                                                                       \
+    if (!dst || (!pairs && !keys)) {                                        \
+        free(dst);                                                          \
+        free(pairs);                                                        \
+        free(keys);                                                         \
+        return RADIX_NO_MEMORY;                                             \
+    }                                                                       \
+    if (pairs) {                                                            \
+        for (i = 0; i < count; i++) {                                       \
+            pairs[i] = keyIndex32(keyOf(&arr[i]), (uint32_t) i);            \
+        }                                                                   \
+        RadixStatus status = sortKeys32(pairs, count);                      \
+        if (status == RADIX_OK) {                                           \
+            for (i = 0; i < count; i++) dst[i] = arr[(uint32_t) pairs[i]];  \
+            memcpy(arr, dst, sizeof(type) * count);                         \
+        }                                                                   \
+        free(pairs);                                                        \
+        free(dst);                                                          \
+        return status;                                                      \
+    }                                                                       \
+    keySrc = keys;                                                          \
+    keyDst = keys + count;                                                  \
+    for (i = 0; i < count; i++) {                                           \
+        keys[i] = keyOf(&arr[i]);                                           \
+        for (d = 0; d < 4; d++) hist[d][(keys[i] >> (8 * d)) & 0xFF]++;     \
+    }                                                                       \
+    for (d = 0; d < 4; d++) {                                               \
+        if (hist[d][(keySrc[0] >> (8 * d)) & 0xFF] == count) continue;      \
+        for (b = 0, total = 0; b < 256; b++) {                              \
+            c = hist[d][b];                                                 \
+            hist[d][b] = total;                                             \
+            total += c;                                                     \
+        }                                                                   \
+        for (i = 0; i < count; i++) {                                       \
+            pos = hist[d][(keySrc[i] >> (8 * d)) & 0xFF]++;                 \
+            keyDst[pos] = keySrc[i];                                        \
+            dst[pos] = src[i];                                              \
+        }                                                                   \
+        keySwap = keySrc;                                                   \
+        keySrc = keyDst;                                                    \
+        keyDst = keySwap;                                                   \
+        swap = src;                                                         \
+        src = dst;                                                          \
+        dst = swap;                                                         \
+    }                                                                       \
+    if (src != arr) {                                                       \
+        memcpy(arr, src, sizeof(type) * count);                             \
+        dst = src;                                                          \
+    }                                                                       \
+    free(keys);                                                             \
+    free(dst);                                                              \
+    return RADIX_OK;                                                        \
+}
+
+/*Like DEFINE_RADIX_SORT, but keyOf gives a null-terminated string.*/
+#define DEFINE_STRING_RADIX_SORT(name, type, keyOf)                         \
+RadixStatus name(type *arr, size_t count) {                                 \
+    StringIndex *pairs;                                                     \
+    type *temp;                                                             \
+    size_t i;                                                               \
+    if (count < 2) return RADIX_OK;                                         \
+    pairs = (StringIndex*) malloc (sizeof(StringIndex) * count);            \
+    temp = (type*) malloc (sizeof(type) * count);                           \
+    if (!pairs || !temp) {                                                  \
+        free(pairs);                                                        \
+        free(temp);                                                         \
+        return RADIX_NO_MEMORY;                                             \
+    }                                                                       \
+    for (i = 0; i < count; i++) {                                           \
+        pairs[i].str = keyOf(&arr[i]);                                      \
+        pairs[i].len = strlen(pairs[i].str);                                \
+        pairs[i].idx = i;                                                   \
+    }                                                                       \
+    RadixStatus status = sortStringKeys(pairs, count);                      \
+    if (status == RADIX_OK) {                                               \
+        for (i = 0; i < count; i++) temp[i] = arr[pairs[i].idx];            \
+        memcpy(arr, temp, sizeof(type) * count);                            \
+    }                                                                       \
+    free(pairs);                                                            \
+    free(temp);                                                             \
+    return status;                                                          \
+}
+
+#endif
@@ -0,0 +1,566 @@
+/**
+ * Benchmark for the sorting programmes in this repository.
+ *
+ * Every trial runs in a child process: the child generates the dataset,
+ * times the sort with CLOCK_MONOTONIC, checks the result and reports the
+ * time back through a pipe, and the parent reads the child's peak RSS
+ * from wait4. A trial therefore never inherits memory from an earlier one.
+ *
+ * Usage: benchmark [-n sizes] [-t trials] [-a algorithms] [-d datasets] [-f csv|json] [-x]
+ * -n: Comma-separated sizes, each a whole number from 1 up; defaults to
+ *     1000,10000,...,100000000.
+ * -t: Trials per size; defaults to 3.
+ * -a: Comma-separated algorithms to run; defaults to all of them.
+ * -d: Comma-separated datasets to use; defaults to all of them.
+ * -f: Output format; defaults to csv.
+ * -x: Also run the quadratic sorts and mergeSort past their size limits.
+ *
+ * Build with the Makefile in this folder.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "../word_tokenizer.h"
+#include "../int_parser.h"
+#include "../SortingCodes/sorting_codes.h"
+
+#define MAX_SIZES 32
+#define FEW_UNIQUE 16 // Distinct values in the few-unique datasets
+
+// Same layout as in sortTriangles.c
+struct Triangle
+{
+  float side1, side2, side3;
+};
+
+// Sorts linked in from the programmes; the Makefile renames the clashes
+void int_bubble(int *, int);
+int int_radix_sort(int *, int);
+int string_radix_sort(const char *, Word *, long, long);
+void bubble_sort(const char *, Word *, int);
+void mergeSort(struct Triangle[], int, int);
+
+// Ranges small enough for the sorting network are finished by it
+DEFINE_SORT_BASE(pdqsort_ints, int, *a < *b, NETWORK_MAX, network_sort)
+
+typedef enum
+{
+  INTS,
+  STRINGS,
+  TRIANGLES
+} Kind;
+
+typedef struct
+{
+  const char *name;
+  Kind kind;
+  long limit; // Largest size run without -x
+} Algorithm;
+
+typedef struct
+{
+  int *ints;
+  char *slab;
+  Word *words;
+  struct Triangle *triangles;
+  long n;
+} Dataset;
+
+Algorithm algorithms[] = {
+    {"bubble", INTS, 100000},
+    {"selection", INTS, 100000},
+    {"powersort", INTS, 0},
+    {"pdqsort", INTS, 0},
+    {"radix_sort", INTS, 0},
+    {"string_radix_sort", STRINGS, 0},
+    {"bubble_sort", STRINGS, 100000},
+    {"mergeSort", TRIANGLES, 100000}, // merge keeps its halves on the stack
+};
+const char *datasets[] = {"random", "sorted", "reversed", "few_unique", "skewed"};
+const char *compare_slab; // Slab of the words compare_strings is comparing
+
+int run_trial(Algorithm *, int, long, double *, long *);
+int generate(Dataset *, Kind, int, long);
+double run_sort(Algorithm *, Dataset *);
+int check_sorted(Kind, Dataset *);
+void free_dataset(Dataset *);
+int in_list(const char *, const char *);
+int compare_doubles(const void *, const void *);
+int compare_ints(const void *, const void *);
+int compare_strings(const void *, const void *);
+int compare_triangles(const void *, const void *);
+unsigned long next_random(unsigned long *);
+
+/**
+ * Return codes:
+ * 0: Success
+ * 1: Unknown option
+ * 2: A trial failed
+ */
+int main(int argc, char **argv)
+{
+  long sizes[MAX_SIZES] = {1000, 10000, 100000, 1000000, 10000000, 100000000},
+       peak_rss, max_rss;
+  int64_t value;
+  double *times, total, size;
+  int size_count = 6, trials = 3, json = 0, no_limits = 0, first = 1,
+      bad_option = 0, // Set if an option or its value is not recognised
+      opt, a, d, s, t, res = 0;
+  const char *algorithm_list = NULL, *dataset_list = NULL;
+  char *token, *end;
+
+  while ((opt = getopt(argc, argv, "n:t:a:d:f:x")) != -1)
+  {
+    switch (opt)
+    {
+    case 'n':
+      size_count = 0;
+      for (token = strtok(optarg, ","); token != NULL && size_count < MAX_SIZES; token = strtok(NULL, ","))
+      {
+        size = strtod(token, &end); // Accepts 1e6 as well as 1000000
+        // The int sorts take their size as an int
+        if (end == token || *end != '\0' || !(size >= 1 && size <= INT32_MAX) || size != (double)(long)size)
+        {
+          bad_option = 1;
+        }
+        else
+        {
+          sizes[size_count++] = (long)size;
+        }
+      }
+      bad_option |= size_count == 0;
+      break;
+    case 't':
+      trials = parse_int(optarg, strlen(optarg), &value) && value <= INT32_MAX ? (int)value : 0;
+      break;
+    case 'a':
+      algorithm_list = optarg;
+      break;
+    case 'd':
+      dataset_list = optarg;
+      break;
+    case 'f':
+      json = strcmp(optarg, "json") == 0;
+      if (!json && strcmp(optarg, "csv") != 0)
+      {
+        bad_option = 1;
+      }
+      break;
+    case 'x':
+      no_limits = 1;
+      break;
+    default:
+      bad_option = 1;
+    }
+  }
+  if (bad_option || trials < 1)
+  {
+    printf("Usage: %s [-n sizes] [-t trials] [-a algorithms] [-d datasets] [-f csv|json] [-x]\n", argv[0]);
+    return 1;
+  }
+
+  times = (double *)malloc(sizeof(double) * trials);
+  if (times == NULL)
+  {
+    printf("Memory allocation failed.\n");
+    return 2;
+  }
+
+  printf(json ? "[\n" : "algorithm,dataset,n,trials,min_s,median_s,mean_s,elements_per_s,peak_rss_kb\n");
+
+  for (a = 0; a < (int)(sizeof(algorithms) / sizeof(algorithms[0])); a++)
+  {
+    if (algorithm_list != NULL && !in_list(algorithm_list, algorithms[a].name))
+    {
+      continue;
+    }
+    for (d = 0; d < (int)(sizeof(datasets) / sizeof(datasets[0])); d++)
+    {
+      if (dataset_list != NULL && !in_list(dataset_list, datasets[d]))
+      {
+        continue;
+      }
+      for (s = 0; s < size_count; s++)
+      {
+        if (!no_limits && algorithms[a].limit && sizes[s] > algorithms[a].limit)
+        {
+          continue;
+        }
+
+        total = 0;
+        max_rss = 0;
+        for (t = 0; t < trials; t++)
+        {
+          if (run_trial(&algorithms[a], d, sizes[s], &times[t], &peak_rss))
+          {
+            fprintf(stderr, "%s on %s with %ld elements failed.\n", algorithms[a].name, datasets[d], sizes[s]);
+            res = 2;
+            break;
+          }
+          total += times[t];
+          max_rss = peak_rss > max_rss ? peak_rss : max_rss;
+        }
+        if (t < trials)
+        {
+          continue;
+        }
+
+        qsort(times, trials, sizeof(double), compare_doubles);
+        printf(json ? "%s  {\"algorithm\": \"%s\", \"dataset\": \"%s\", \"n\": %ld, \"trials\": %d, "
+                      "\"min_s\": %.9f, \"median_s\": %.9f, \"mean_s\": %.9f, \"elements_per_s\": %.0f, \"peak_rss_kb\": %ld}"
+                    : "%s%s,%s,%ld,%d,%.9f,%.9f,%.9f,%.0f,%ld",
+               json && !first ? ",\n" : "", algorithms[a].name, datasets[d], sizes[s], trials,
+               times[0], times[trials / 2], total / trials, sizes[s] / times[trials / 2], max_rss);
+        if (!json)
+        {
+          printf("\n");
+        }
+        fflush(stdout);
+        first = 0;
+      }
+    }
+  }
+
+  printf(json ? "\n]\n" : "");
+  free(times);
+  return res;
+}
+
+/**
+ * Runs one trial in a child process.
+ * Returns 0 if the child sorted the data correctly, 1 otherwise.
+ */
+int run_trial(Algorithm *algorithm, int dataset, long n, double *seconds, long *peak_rss)
+{
+  struct rusage usage;
+  Dataset data;
+  pid_t pid;
+  int fds[2], status, failed;
+
+  if (pipe(fds) != 0)
+  {
+    return 1;
+  }
+
+  fflush(stdout);
+  pid = fork();
+  if (pid < 0)
+  {
+    close(fds[0]);
+    close(fds[1]);
+    return 1;
+  }
+
+  if (pid == 0) // Child: generate, sort, check, report
+  {
+    close(fds[0]);
+    if (generate(&data, algorithm->kind, dataset, n))
+    {
+      _exit(1);
+    }
+    *seconds = run_sort(algorithm, &data);
+    if (*seconds < 0 || !check_sorted(algorithm->kind, &data))
+    {
+      _exit(1);
+    }
+    if (write(fds[1], seconds, sizeof(double)) != sizeof(double))
+    {
+      _exit(1);
+    }
+    _exit(0);
+  }
+
+  close(fds[1]);
+  failed = read(fds[0], seconds, sizeof(double)) != sizeof(double);
+  close(fds[0]);
+
+  if (wait4(pid, &status, 0, &usage) < 0)
+  {
+    return 1;
+  }
+  *peak_rss = usage.ru_maxrss; // Kilobytes on Linux
+  return failed || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+}
+
+/**
+ * Times one call to the algorithm.
+ * Returns the wall time in seconds, or -1 if the sort failed.
+ */
+double run_sort(Algorithm *algorithm, Dataset *data)
+{
+  struct timespec start, end;
+  int failed = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  if (strcmp(algorithm->name, "bubble") == 0)
+  {
+    if (data->n > 1) // It compares the last element with the one before it
+    {
+      int_bubble(data->ints, data->n);
+    }
+  }
+  else if (strcmp(algorithm->name, "selection") == 0)
+  {
+    selection(data->ints, data->n);
+  }
+  else if (strcmp(algorithm->name, "pdqsort") == 0)
+  {
+    pdqsort_ints(data->ints, data->n);
+  }
+  else if (strcmp(algorithm->name, "powersort") == 0)
+  {
+    failed = !powersort(data->ints, data->n); // Returns 1 on success
+  }
+  else if (strcmp(algorithm->name, "radix_sort") == 0)
+  {
+    failed = !int_radix_sort(data->ints, data->n); // Returns 1 on success
+  }
+  else if (strcmp(algorithm->name, "string_radix_sort") == 0)
+  {
+    failed = string_radix_sort(data->slab, data->words, data->n, 0);
+  }
+  else if (strcmp(algorithm->name, "bubble_sort") == 0)
+  {
+    bubble_sort(data->slab, data->words, data->n);
+  }
+  else
+  {
+    mergeSort(data->triangles, 0, data->n - 1);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  return failed ? -1 : (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/**
+ * Fills the dataset for a kind of algorithm. Every trial uses the same
+ * seed, so the trials of one size sort the same data.
+ * Returns 0 if successful, 1 if memory allocation fails.
+ */
+int generate(Dataset *data, Kind kind, int dataset, long n)
+{
+  unsigned long seed = 12345 + n, r;
+  long i, j, len, used = 0;
+
+  memset(data, 0, sizeof(Dataset));
+  data->n = n;
+
+  if (kind == INTS)
+  {
+    data->ints = (int *)malloc(sizeof(int) * n);
+    if (data->ints == NULL)
+    {
+      return 1;
+    }
+    for (i = 0; i < n; i++)
+    {
+      r = next_random(&seed);
+      if (strcmp(datasets[dataset], "few_unique") == 0)
+      {
+        data->ints[i] = (r % FEW_UNIQUE) * 1000003;
+      }
+      else if (strcmp(datasets[dataset], "skewed") == 0) // Mostly small, a few with many digits
+      {
+        data->ints[i] = r % 100 ? (int)(r % 1000) : (int)(r % 2147483647);
+      }
+      else
+      {
+        data->ints[i] = r % 2147483647;
+      }
+    }
+  }
+  else if (kind == STRINGS)
+  {
+    // Words are at most 16 characters, or 200 for the rare long ones
+    data->slab = (char *)malloc(sizeof(char) * n * 17 + 200);
+    data->words = (Word *)malloc(sizeof(Word) * n);
+    if (data->slab == NULL || data->words == NULL)
+    {
+      free_dataset(data);
+      return 1;
+    }
+    for (i = 0; i < n; i++)
+    {
+      r = next_random(&seed);
+      if (strcmp(datasets[dataset], "skewed") == 0) // Mostly short, one in a thousand very long
+      {
+        len = r % 1000 == 0 && used + 201 <= n * 17 ? 200 : 1 + r % 4;
+      }
+      else
+      {
+        len = 4 + r % 12;
+      }
+      if (strcmp(datasets[dataset], "few_unique") == 0)
+      {
+        seed = r % FEW_UNIQUE + 1; // Restart the sequence at one of a few points
+      }
+      data->words[i].off = used;
+      data->words[i].len = len;
+      for (j = 0; j < len; j++)
+      {
+        data->slab[used++] = 'a' + next_random(&seed) % 26;
+      }
+      data->slab[used++] = '\0';
+      if (strcmp(datasets[dataset], "few_unique") == 0)
+      {
+        seed = 12345 + n + i; // Back to the main sequence
+      }
+    }
+  }
+  else
+  {
+    data->triangles = (struct Triangle *)malloc(sizeof(struct Triangle) * n);
+    if (data->triangles == NULL)
+    {
+      return 1;
+    }
+    for (i = 0; i < n; i++)
+    {
+      r = next_random(&seed);
+      if (strcmp(datasets[dataset], "few_unique") == 0)
+      {
+        r %= FEW_UNIQUE;
+      }
+      else if (strcmp(datasets[dataset], "skewed") == 0)
+      {
+        r = r % 100 ? r % 10 : r;
+      }
+      data->triangles[i].side1 = r % 1000 + 1;
+      data->triangles[i].side2 = r % 997 + 1;
+      data->triangles[i].side3 = r % 991 + 1;
+    }
+  }
+
+  // Sorted and reversed data is random data put in order before timing
+  if (strcmp(datasets[dataset], "sorted") == 0 || strcmp(datasets[dataset], "reversed") == 0)
+  {
+    if (kind == INTS)
+    {
+      qsort(data->ints, n, sizeof(int), compare_ints);
+    }
+    else if (kind == STRINGS)
+    {
+      compare_slab = data->slab;
+      qsort(data->words, n, sizeof(Word), compare_strings);
+    }
+    else
+    {
+      qsort(data->triangles, n, sizeof(struct Triangle), compare_triangles);
+    }
+  }
+  if (strcmp(datasets[dataset], "reversed") == 0)
+  {
+    for (i = 0, j = n - 1; i < j; i++, j--)
+    {
+      if (kind == INTS)
+      {
+        r = data->ints[i];
+        data->ints[i] = data->ints[j];
+        data->ints[j] = r;
+      }
+      else if (kind == STRINGS)
+      {
+        Word w = data->words[i];
+        data->words[i] = data->words[j];
+        data->words[j] = w;
+      }
+      else
+      {
+        struct Triangle tr = data->triangles[i];
+        data->triangles[i] = data->triangles[j];
+        data->triangles[j] = tr;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Whether the dataset is in order after the sort.
+ */
+int check_sorted(Kind kind, Dataset *data)
+{
+  long i;
+
+  compare_slab = data->slab;
+  for (i = 1; i < data->n; i++)
+  {
+    if ((kind == INTS && data->ints[i - 1] > data->ints[i]) ||
+        (kind == STRINGS && compare_strings(&data->words[i - 1], &data->words[i]) > 0) ||
+        (kind == TRIANGLES && compare_triangles(&data->triangles[i - 1], &data->triangles[i]) > 0))
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+void free_dataset(Dataset *data)
+{
+  free(data->ints);
+  free(data->slab);
+  free(data->words);
+  free(data->triangles);
+}
+
+/**
+ * Whether name is one of the entries of a comma-separated list.
+ */
+int in_list(const char *list, const char *name)
+{
+  size_t len = strlen(name);
+  const char *p;
+
+  for (p = strstr(list, name); p != NULL; p = strstr(p + 1, name))
+  {
+    if ((p == list || p[-1] == ',') && (p[len] == ',' || p[len] == '\0'))
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int compare_doubles(const void *a, const void *b)
+{
+  return (*(double *)a > *(double *)b) - (*(double *)a < *(double *)b);
+}
+
+int compare_ints(const void *a, const void *b)
+{
+  return (*(int *)a > *(int *)b) - (*(int *)a < *(int *)b);
+}
+
+int compare_strings(const void *a, const void *b)
+{
+  return strcmp(compare_slab + ((Word *)a)->off, compare_slab + ((Word *)b)->off);
+}
+
+// Triangles sort by perimeter, as in sortTriangles.c
+int compare_triangles(const void *a, const void *b)
+{
+  const struct Triangle *x = (const struct Triangle *)a, *y = (const struct Triangle *)b;
+  float px = x->side1 + x->side2 + x->side3, py = y->side1 + y->side2 + y->side3;
+
+  return (px > py) - (px < py);
+}
+
+/**
+ * xorshift64* generator, so the datasets are the same on every machine.
+ */
+unsigned long next_random(unsigned long *state)
+{
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return (*state * 2685821657736338717UL) >> 1;
+}
@@ -1,4 +1,14 @@
-void selection(int* a, int n) {
+#ifndef SORTING_CODES_H
+#define SORTING_CODES_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+static inline void selection(int* a, int n) {
 	while (--n) {
 		int temp = a[n];
 		int index = n, j = n;
@@ -13,7 +23,7 @@ void selection(int* a, int n) {
 	}
 }
 
-void bubble (int* a, int n) {
+static inline void bubble (int* a, int n) {
 	int i = n - 1, sorted, temp;
 	do {
 		sorted = 0;
@@ -28,3 +38,603 @@ void bubble (int* a, int n) {
 		} while (--j);
 	} while (--i && sorted);
 }
+
+#define NETWORK_MAX 32 /* Most elements the sorting networks take */
+
+/*
+ * Sorting networks for arrays of up to NETWORK_MAX ints or floats: a fixed
+ * sequence of compare-exchanges that does not depend on the data, so there
+ * are no branches to mispredict. The array is padded to 4, 8, 16 or 32
+ * elements. 4 use the optimal network of five compare-exchanges. Larger
+ * sizes use bitonic networks, 8 elements to an AVX2 register (when
+ * compiled with -mavx2 or -march=native) with lane permutes, min and max,
+ * or a scalar loop over the same network elsewhere. 64-bit ints always
+ * take the scalar loop.
+ */
+#ifdef __AVX2__
+/* One compare-exchange stage on the 8 lanes of v: each lane meets the one
+   perm gives it, and the lanes set in mask keep the larger value. */
+#define NETWORK_STAGE(v, perm, mask) do { \
+	__m256i partner = _mm256_permutevar8x32_epi32(v, perm); \
+	v = _mm256_blend_epi32(_mm256_min_epi32(v, partner), _mm256_max_epi32(v, partner), mask); \
+} while (0)
+
+/* Sorts 8 lanes that hold a bitonic sequence. */
+static inline __m256i network_merge8(__m256i v) {
+	NETWORK_STAGE(v, _mm256_setr_epi32(4, 5, 6, 7, 0, 1, 2, 3), 0xF0);
+	NETWORK_STAGE(v, _mm256_setr_epi32(2, 3, 0, 1, 6, 7, 4, 5), 0xCC);
+	NETWORK_STAGE(v, _mm256_setr_epi32(1, 0, 3, 2, 5, 4, 7, 6), 0xAA);
+	return v;
+}
+
+static inline __m256i network_sort8(__m256i v) {
+	NETWORK_STAGE(v, _mm256_setr_epi32(1, 0, 3, 2, 5, 4, 7, 6), 0x66);
+	NETWORK_STAGE(v, _mm256_setr_epi32(2, 3, 0, 1, 6, 7, 4, 5), 0x3C);
+	NETWORK_STAGE(v, _mm256_setr_epi32(1, 0, 3, 2, 5, 4, 7, 6), 0x5A);
+	return network_merge8(v);
+}
+
+/* Sorts 16 lanes that hold a bitonic sequence, a first and b second. */
+static inline void network_merge16(__m256i* a, __m256i* b) {
+	__m256i lo = _mm256_min_epi32(*a, *b), hi = _mm256_max_epi32(*a, *b);
+	*a = network_merge8(lo);
+	*b = network_merge8(hi);
+}
+
+static inline __m256i network_reverse(__m256i v) {
+	return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+}
+#endif
+
+/* Bitonic network on n elements of type, n a power of two. */
+#define DEFINE_NETWORK_BITONIC(name, type) \
+static inline void name(type* v, int n) { \
+	int k, j, b, i; \
+	type x, y, lo, hi; \
+	for (k = 2; k <= n; k *= 2) { \
+		for (j = k / 2; j > 0; j /= 2) { \
+			for (b = 0; b < n; b += 2 * j) { \
+				for (i = b; i < b + j; i++) { /* i meets i + j, ascending where bit k of i is clear */ \
+					x = v[i]; \
+					y = v[i + j]; \
+					lo = x < y ? x : y; \
+					hi = x < y ? y : x; \
+					v[i] = (i & k) ? hi : lo; \
+					v[i + j] = (i & k) ? lo : hi; \
+				} \
+			} \
+		} \
+	} \
+}
+
+#ifndef __AVX2__
+DEFINE_NETWORK_BITONIC(network_bitonic, int)
+#endif
+DEFINE_NETWORK_BITONIC(network_bitonic64, long long)
+
+static inline void network_exchange(int* v, int i, int j) {
+	int x = v[i], y = v[j];
+	v[i] = x < y ? x : y;
+	v[j] = x < y ? y : x;
+}
+
+/* Sorts a[0..n) with a sorting network; n must be at most NETWORK_MAX. */
+static inline void network_sort(int* a, int n) {
+	int v[NETWORK_MAX], size = 4, i;
+	if (n < 2) return;
+	while (size < n) size *= 2;
+	memcpy(v, a, sizeof(int) * n);
+	for (i = n; i < size; i++) v[i] = INT_MAX; // Padding sorts to the end
+	if (size == 4) {
+		network_exchange(v, 0, 1);
+		network_exchange(v, 2, 3);
+		network_exchange(v, 0, 2);
+		network_exchange(v, 1, 3);
+		network_exchange(v, 1, 2);
+	} else {
+#ifdef __AVX2__
+		__m256i r[4];
+		for (i = 0; i < size / 8; i++) r[i] = network_sort8(_mm256_loadu_si256((const __m256i*) (v + 8 * i)));
+		if (size >= 16) {
+			for (i = 0; i < size / 8; i += 2) {
+				r[i + 1] = network_reverse(r[i + 1]);
+				network_merge16(&r[i], &r[i + 1]);
+			}
+		}
+		if (size == 32) { // Reverse the second 16 and merge in two halves
+			__m256i rev3 = network_reverse(r[3]), rev2 = network_reverse(r[2]);
+			__m256i lo0 = _mm256_min_epi32(r[0], rev3), hi0 = _mm256_max_epi32(r[0], rev3);
+			__m256i lo1 = _mm256_min_epi32(r[1], rev2), hi1 = _mm256_max_epi32(r[1], rev2);
+			network_merge16(&lo0, &lo1);
+			network_merge16(&hi0, &hi1);
+			r[0] = lo0;
+			r[1] = lo1;
+			r[2] = hi0;
+			r[3] = hi1;
+		}
+		for (i = 0; i < size / 8; i++) _mm256_storeu_si256((__m256i*) (v + 8 * i), r[i]);
+#else
+		network_bitonic(v, size);
+#endif
+	}
+	memcpy(a, v, sizeof(int) * n);
+}
+
+/* Sorts floats with network_sort, through ints that compare in the same
+   order: negative floats have every bit but the sign flipped. NaNs go
+   past the infinities, to the end or the start by their sign. */
+static inline void network_sort_float(float* a, int n) {
+	int v[NETWORK_MAX], i;
+	if (n < 2) return;
+	memcpy(v, a, sizeof(float) * n);
+	for (i = 0; i < n; i++) v[i] ^= (v[i] >> 31) & 0x7FFFFFFF;
+	network_sort(v, n);
+	for (i = 0; i < n; i++) v[i] ^= (v[i] >> 31) & 0x7FFFFFFF;
+	memcpy(a, v, sizeof(float) * n);
+}
+
+/* Sorts a[0..n) of 64-bit ints with the scalar bitonic network, padded
+   to a power of two; n must be at most NETWORK_MAX. */
+static inline void network_sort64(long long* a, int n) {
+	long long v[NETWORK_MAX];
+	int size = 2, i;
+	if (n < 2) return;
+	while (size < n) size *= 2;
+	memcpy(v, a, sizeof(long long) * n);
+	for (i = n; i < size; i++) v[i] = LLONG_MAX;
+	network_bitonic64(v, size);
+	memcpy(a, v, sizeof(long long) * n);
+}
+
+#define MIN_RUN NETWORK_MAX
+#define MIN_GALLOP 7
+
+static int before(int x, int key, int right) {
+	return right ? x <= key : x < key;
+}
+
+/* Number of elements of a that are less than key, or at most key with
+   right set, probing 1, 2, 4, ... places in from the front or the end. */
+static size_t gallop(const int* a, size_t n, int key, int right, int from_end) {
+	size_t lo = 0, hi = n, step = 1, mid;
+	if (from_end) {
+		while (hi > lo) {
+			mid = hi > step ? hi - step : 0;
+			if (before(a[mid], key, right)) {
+				lo = mid + 1;
+				break;
+			}
+			hi = mid;
+			step *= 2;
+		}
+	} else {
+		while (lo < hi) {
+			mid = lo + step - 1 < hi ? lo + step - 1 : hi - 1;
+			if (!before(a[mid], key, right)) {
+				hi = mid;
+				break;
+			}
+			lo = mid + 1;
+			step *= 2;
+		}
+	}
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (before(a[mid], key, right)) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+/* Merges a[0..n1) and a[n1..n1 + n2) with the left run in scratch. */
+static void merge_lo(int* a, size_t n1, size_t n2, int* scratch) {
+	int *left = scratch, *left_end = scratch + n1, *right = a + n1, *right_end = right + n2, *out = a;
+	size_t left_wins = 0, right_wins = 0, count;
+	memcpy(scratch, a, sizeof(int) * n1);
+	while (left < left_end && right < right_end) {
+		if (*right < *left) {
+			*out++ = *right++;
+			right_wins++;
+			left_wins = 0;
+		} else {
+			*out++ = *left++;
+			left_wins++;
+			right_wins = 0;
+		}
+		if (left_wins >= MIN_GALLOP && right < right_end) {
+			count = gallop(left, left_end - left, *right, 1, 0);
+			memcpy(out, left, sizeof(int) * count);
+			out += count;
+			left += count;
+			left_wins = 0;
+		} else if (right_wins >= MIN_GALLOP && left < left_end) {
+			count = gallop(right, right_end - right, *left, 0, 0);
+			memmove(out, right, sizeof(int) * count);
+			out += count;
+			right += count;
+			right_wins = 0;
+		}
+	}
+	memcpy(out, left, sizeof(int) * (left_end - left)); // What is left of the right run is in place
+}
+
+/* Merges a[0..n1) and a[n1..n1 + n2) from the end, with the right run in scratch. */
+static void merge_hi(int* a, size_t n1, size_t n2, int* scratch) {
+	int *left = a + n1, *right = scratch + n2, *out = a + n1 + n2;
+	size_t left_wins = 0, right_wins = 0, count;
+	memcpy(scratch, a + n1, sizeof(int) * n2);
+	while (left > a && right > scratch) {
+		if (right[-1] < left[-1]) {
+			*--out = *--left;
+			left_wins++;
+			right_wins = 0;
+		} else {
+			*--out = *--right;
+			right_wins++;
+			left_wins = 0;
+		}
+		if (left_wins >= MIN_GALLOP && left > a) {
+			count = (left - a) - gallop(a, left - a, right[-1], 1, 1);
+			out -= count;
+			left -= count;
+			memmove(out, left, sizeof(int) * count);
+			left_wins = 0;
+		} else if (right_wins >= MIN_GALLOP && right > scratch) {
+			count = (right - scratch) - gallop(scratch, right - scratch, left[-1], 0, 1);
+			out -= count;
+			right -= count;
+			memcpy(out, right, sizeof(int) * count);
+			right_wins = 0;
+		}
+	}
+	memcpy(a, scratch, sizeof(int) * (right - scratch)); // What is left of the left run is in place
+}
+
+/* Merges two neighbouring sorted runs, leaving out the elements at either
+   end that are already in place and copying the shorter run to scratch. */
+static void merge_runs(int* a, size_t n1, size_t n2, int* scratch) {
+	size_t skip = gallop(a, n1, a[n1], 1, 0);
+	a += skip;
+	n1 -= skip;
+	if (n1 == 0) return;
+	n2 = gallop(a + n1, n2, a[n1 - 1], 0, 1);
+	if (n1 <= n2) merge_lo(a, n1, n2, scratch);
+	else merge_hi(a, n1, n2, scratch);
+}
+
+/* Length of the run that starts at a[lo], made ascending and at least
+   MIN_RUN long if the array has that many elements left. */
+static size_t find_run(int* a, size_t lo, size_t n) {
+	size_t hi = lo + 1, i, j;
+	int temp;
+	if (hi == n) return 1;
+	if (a[hi] < a[lo]) { // Strictly descending, so reversing it keeps equal elements in order
+		while (hi + 1 < n && a[hi + 1] < a[hi]) hi++;
+		for (i = lo, j = hi; i < j; i++, j--) {
+			temp = a[i];
+			a[i] = a[j];
+			a[j] = temp;
+		}
+	} else {
+		while (hi + 1 < n && a[hi + 1] >= a[hi]) hi++;
+	}
+	hi++;
+	if (hi - lo < MIN_RUN && hi < n) { // Equal ints are alike, so the network needs no stability
+		hi = n - lo < MIN_RUN ? n : lo + MIN_RUN;
+		network_sort(a + lo, hi - lo);
+	}
+	return hi - lo;
+}
+
+/* Power of the boundary between runs a[s1..s1 + n1) and the n2 elements
+   after it: the first bit where the fractions that place the two run
+   midpoints in the array differ. */
+static int node_power(size_t s1, size_t n1, size_t n2, size_t n) {
+	size_t a = 2 * s1 + n1, b = a + n1 + n2;
+	int power = 0;
+	for (;;) {
+		power++;
+		if (a >= n) {
+			a -= n;
+			b -= n;
+		} else if (b >= n) {
+			return power;
+		}
+		a <<= 1;
+		b <<= 1;
+	}
+}
+
+/*
+ * Powersort: a stable merge sort on the runs already in the array.
+ * Ascending and strictly descending runs are found as they are, short
+ * ones are extended to MIN_RUN with a sorting network, and each pair of
+ * neighbouring runs gets a power that says how deep their merge belongs
+ * in a balanced merge tree. Runs wait on a stack until a later boundary
+ * has a lower power, so sorted input takes one pass and concatenated
+ * sorted runs take about n log(runs) comparisons, never more than
+ * n log n. Merges gallop once one side keeps winning, and share one
+ * scratch buffer half the size of the array.
+ * Returns 1 if successful, 0 if memory allocation fails.
+ */
+static inline int powersort(int* a, int n) {
+	struct {
+		size_t start, len;
+		int power;
+	} stack[64]; // Powers on the stack only increase, and are at most 64
+	size_t start = 0, len, next, next_len;
+	int top = 0, power;
+	int* scratch;
+	if (n < 2) return 1;
+	scratch = (int*) malloc(sizeof(int) * (n / 2 + 1));
+	if (!scratch) return 0;
+	len = find_run(a, 0, n);
+	while (start + len < (size_t) n) {
+		next = start + len;
+		next_len = find_run(a, next, n);
+		power = node_power(start, len, next_len, n);
+		while (top > 0 && stack[top - 1].power > power) {
+			top--;
+			merge_runs(a + stack[top].start, stack[top].len, len, scratch);
+			start = stack[top].start;
+			len += stack[top].len;
+		}
+		stack[top].start = start;
+		stack[top].len = len;
+		stack[top++].power = power;
+		start = next;
+		len = next_len;
+	}
+	while (top > 0) {
+		top--;
+		merge_runs(a + stack[top].start, stack[top].len, len, scratch);
+		len += stack[top].len;
+	}
+	free(scratch);
+	return 1;
+}
+
+#define SORT_BLOCK 64 /* Elements compared at a time when partitioning */
+#define SORT_INSERTION 24
+#define SORT_NINTHER 128
+#define SORT_PARTIAL_LIMIT 8
+
+/*
+ * DEFINE_SORT(name, type, less_expr) defines void name(type* a, size_t n),
+ * a pattern-defeating quicksort (pdqsort) for arrays of type. less_expr
+ * tells whether the element at pointer a goes before the one at pointer b,
+ * for example a->cost < b->cost, and is compiled into the sort instead of
+ * being called through a function pointer as with qsort.
+ *
+ * Pivots are medians of three, or of three medians of three for large
+ * ranges, and the partition is branchless. A range whose partition needed
+ * no moves is finished with insertion sort if that takes few moves, so
+ * sorted input is linear. A pivot that equals the one before it moves all
+ * of its equal elements aside at once. Bad pivots shuffle the range, and
+ * after about log n of them it is heapsorted, so the worst case is
+ * O(n log n). The sort is not stable.
+ *
+ * DEFINE_SORT_BASE(name, type, less_expr, base_max, base_sort) is the
+ * same sort with ranges of at most base_max elements finished by
+ * base_sort(type* a, int n) instead of insertion sort, for example
+ * NETWORK_MAX and network_sort for ints in ascending order. base_max must
+ * be at least SORT_INSERTION - 1, and base_sort must put the elements in
+ * the order less_expr gives.
+ */
+#define DEFINE_SORT(name, type, less_expr) \
+	DEFINE_SORT_BASE(name, type, less_expr, SORT_INSERTION - 1, name##_insertion)
+
+#define DEFINE_SORT_BASE(name, type, less_expr, base_max, base_sort) \
+static inline int name##_less(const type* a, const type* b) { \
+	return (less_expr); \
+} \
+static inline void name##_swap(type* a, type* b) { \
+	type temp = *a; \
+	*a = *b; \
+	*b = temp; \
+} \
+static inline void name##_sort2(type* a, type* b) { \
+	if (name##_less(b, a)) name##_swap(a, b); \
+} \
+static inline void name##_sort3(type* a, type* b, type* c) { \
+	name##_sort2(a, b); \
+	name##_sort2(b, c); \
+	name##_sort2(a, b); \
+} \
+static inline void name##_insertion(type* begin, int n) { \
+	type *end = begin + n, *cur, *sift, temp; \
+	for (cur = begin + 1; cur < end; cur++) { \
+		if (!name##_less(cur, cur - 1)) continue; \
+		temp = *cur; \
+		for (sift = cur; sift > begin && name##_less(&temp, sift - 1); sift--) *sift = sift[-1]; \
+		*sift = temp; \
+	} \
+} \
+/* Insertion sort that gives up after SORT_PARTIAL_LIMIT moves. */ \
+static int name##_partial_insertion(type* begin, type* end) { \
+	type *cur, *sift, temp; \
+	size_t moves = 0; \
+	for (cur = begin + 1; cur < end; cur++) { \
+		if (!name##_less(cur, cur - 1)) continue; \
+		temp = *cur; \
+		for (sift = cur; sift > begin && name##_less(&temp, sift - 1); sift--) *sift = sift[-1]; \
+		*sift = temp; \
+		moves += cur - sift; \
+		if (moves > SORT_PARTIAL_LIMIT) return 0; \
+	} \
+	return 1; \
+} \
+static void name##_sift_down(type* a, size_t i, size_t n) { \
+	size_t child; \
+	type temp = a[i]; \
+	while ((child = 2 * i + 1) < n) { \
+		if (child + 1 < n && name##_less(&a[child], &a[child + 1])) child++; \
+		if (!name##_less(&temp, &a[child])) break; \
+		a[i] = a[child]; \
+		i = child; \
+	} \
+	a[i] = temp; \
+} \
+static void name##_heapsort(type* a, size_t n) { \
+	size_t i; \
+	for (i = n / 2; i > 0; i--) name##_sift_down(a, i - 1, n); \
+	for (i = n - 1; i > 0; i--) { \
+		name##_swap(&a[0], &a[i]); \
+		name##_sift_down(a, 0, i); \
+	} \
+} \
+/* Partitions around the pivot at *begin, with the elements equal to it on \
+   the left. Used when the pivot equals the element before the range, so \
+   every element is at least the pivot and the left part is all equal. */ \
+static type* name##_partition_left(type* begin, type* end) { \
+	type pivot = *begin, *first = begin, *last = end; \
+	while (name##_less(&pivot, --last)); \
+	if (last + 1 == end) while (first < last && !name##_less(&pivot, ++first)); \
+	else while (!name##_less(&pivot, ++first)); \
+	while (first < last) { \
+		name##_swap(first, last); \
+		while (name##_less(&pivot, --last)); \
+		while (!name##_less(&pivot, ++first)); \
+	} \
+	*begin = *last; \
+	*last = pivot; \
+	return last; \
+} \
+/* Partitions around the pivot at *begin, with the elements equal to it on \
+   the right, and returns where the pivot ends up. Elements are compared a \
+   block at a time, writing the offsets of the ones on the wrong side \
+   instead of branching on each comparison, then the misplaced pairs are \
+   swapped. already is set if nothing had to move. */ \
+static type* name##_partition_right(type* begin, type* end, int* already) { \
+	unsigned char offsets_l[SORT_BLOCK], offsets_r[SORT_BLOCK]; \
+	type pivot = *begin, *first = begin, *last = end, *base_l, *base_r, *l, *r, temp; \
+	size_t num_l = 0, num_r = 0, start_l = 0, start_r = 0, unknown, split_l, split_r, num, i; \
+	while (name##_less(++first, &pivot)); \
+	if (first - 1 == begin) while (first < last && !name##_less(--last, &pivot)); \
+	else while (!name##_less(--last, &pivot)); \
+	*already = first >= last; \
+	if (!*already) { \
+		name##_swap(first, last); \
+		first++; \
+		base_l = first; \
+		base_r = last; \
+		while (first < last) { \
+			unknown = last - first; \
+			split_l = num_l == 0 ? (num_r == 0 ? unknown / 2 : unknown) : 0; \
+			split_r = num_r == 0 ? unknown - split_l : 0; \
+			if (split_l > SORT_BLOCK) split_l = SORT_BLOCK; \
+			if (split_r > SORT_BLOCK) split_r = SORT_BLOCK; \
+			for (i = 0; i < split_l; i++) { \
+				offsets_l[num_l] = (unsigned char) i; \
+				num_l += !name##_less(first++, &pivot); \
+			} \
+			for (i = 0; i < split_r; i++) { \
+				offsets_r[num_r] = (unsigned char) (i + 1); \
+				num_r += name##_less(--last, &pivot); \
+			} \
+			num = num_l < num_r ? num_l : num_r; \
+			if (num > 0) { /* A cycle of moves instead of swaps */ \
+				l = base_l + offsets_l[start_l]; \
+				r = base_r - offsets_r[start_r]; \
+				temp = *l; \
+				*l = *r; \
+				for (i = 1; i < num; i++) { \
+					l = base_l + offsets_l[start_l + i]; \
+					*r = *l; \
+					r = base_r - offsets_r[start_r + i]; \
+					*l = *r; \
+				} \
+				*r = temp; \
+			} \
+			num_l -= num; \
+			num_r -= num; \
+			start_l += num; \
+			start_r += num; \
+			if (num_l == 0) { \
+				start_l = 0; \
+				base_l = first; \
+			} \
+			if (num_r == 0) { \
+				start_r = 0; \
+				base_r = last; \
+			} \
+		} \
+		if (num_l) { /* Misplaced elements left on one side go to the middle */ \
+			while (num_l--) name##_swap(base_l + offsets_l[start_l + num_l], --last); \
+			first = last; \
+		} \
+		if (num_r) { \
+			while (num_r--) name##_swap(base_r - offsets_r[start_r + num_r], first++); \
+		} \
+	} \
+	*begin = first[-1]; \
+	first[-1] = pivot; \
+	return first - 1; \
+} \
+static void name##_loop(type* begin, type* end, int bad_allowed, int leftmost) { \
+	size_t size, half, l_size, r_size; \
+	type* pivot; \
+	int already; \
+	for (;;) { \
+		size = end - begin; \
+		if (size <= (base_max)) { \
+			base_sort(begin, (int) size); \
+			return; \
+		} \
+		half = size / 2; \
+		if (size > SORT_NINTHER) { /* Median of medians of three */ \
+			name##_sort3(begin, begin + half, end - 1); \
+			name##_sort3(begin + 1, begin + half - 1, end - 2); \
+			name##_sort3(begin + 2, begin + half + 1, end - 3); \
+			name##_sort3(begin + half - 1, begin + half, begin + half + 1); \
+			name##_swap(begin, begin + half); \
+		} else { \
+			name##_sort3(begin + half, begin, end - 1); \
+		} \
+		if (!leftmost && !name##_less(begin - 1, begin)) { /* Many equal elements */ \
+			begin = name##_partition_left(begin, end) + 1; \
+			continue; \
+		} \
+		pivot = name##_partition_right(begin, end, &already); \
+		l_size = pivot - begin; \
+		r_size = end - pivot - 1; \
+		if (l_size < size / 8 || r_size < size / 8) { /* Bad pivot: shuffle, or give up on quicksort */ \
+			if (--bad_allowed == 0) { \
+				name##_heapsort(begin, size); \
+				return; \
+			} \
+			if (l_size >= SORT_INSERTION) { \
+				name##_swap(begin, begin + l_size / 4); \
+				name##_swap(pivot - 1, pivot - l_size / 4); \
+				if (l_size > SORT_NINTHER) { \
+					name##_swap(begin + 1, begin + l_size / 4 + 1); \
+					name##_swap(begin + 2, begin + l_size / 4 + 2); \
+					name##_swap(pivot - 2, pivot - l_size / 4 - 1); \
+					name##_swap(pivot - 3, pivot - l_size / 4 - 2); \
+				} \
+			} \
+			if (r_size >= SORT_INSERTION) { \
+				name##_swap(pivot + 1, pivot + 1 + r_size / 4); \
+				name##_swap(end - 1, end - r_size / 4); \
+				if (r_size > SORT_NINTHER) { \
+					name##_swap(pivot + 2, pivot + 2 + r_size / 4); \
+					name##_swap(pivot + 3, pivot + 3 + r_size / 4); \
+					name##_swap(end - 2, end - r_size / 4 - 1); \
+					name##_swap(end - 3, end - r_size / 4 - 2); \
+				} \
+			} \
+		} else if (already && name##_partial_insertion(begin, pivot) && name##_partial_insertion(pivot + 1, end)) { \
+			return; \
+		} \
+		name##_loop(begin, pivot, bad_allowed, leftmost); \
+		begin = pivot + 1; \
+		leftmost = 0; \
+	} \
+} \
+void name(type* a, size_t n) { \
+	int bad_allowed = 1; \
+	while (n >> bad_allowed) bad_allowed++; \
+	if (n > 1) name##_loop(a, a + n, bad_allowed, 1); \
+}
+
+#endif
@@ -1,45 +1,147 @@
+/**
+ * Usage: bubble-sort numbers...
+ *        bubble-sort [-b] [-o output] -f file
+ * -f: Sort the numbers in a file instead of the arguments, separated by
+ *     spaces or newlines, or raw little-endian 32-bit integers with -b.
+ *     The sorted numbers are written one per line or in binary.
+ * -b: The file is binary.
+ * -o: Output file for -f; defaults to standard output.
+ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include "number_file.h"
 
 void bubble(int *a, int);
-int _atoi(char *);
 
+#ifndef SORT_BENCHMARK
+/**
+ * Return codes:
+ * 0: Success
+ * 1: Not enough arguments
+ * 2: Memory allocation failed
+ * 3: An argument or line is not a whole number that fits in an int
+ * 4: Unknown option
+ * 5: Error opening file
+ * 6: Binary file size is not a whole number of integers
+ * 7: Error writing output file
+ */
 int main(int argc, char **argv)
 {
-  if (argc == 1) // Failsafe case if there aren't enough arguments
+  int binary = 0, // The file holds raw integers
+      first = 1,  // First argument that is a number
+      *arr,       // Integer array to store the numbers
+      i, j = 0,   // Iterators for loops
+      opt, res = 0;
+  long size,        // Number of numbers
+      mapped = -1;  // Size of the mapped binary file, or -1 if arr was allocated
+  const char *input = NULL, *output = NULL, *value = NULL;
+
+  while ((opt = next_number_option(argc, argv, &first, "bfo", "fo", &value)) != 0)
   {
-    printf("Not enough arguments; please enter an array of numbers separated by a space.\n");
-    return 1;
+    if (opt == '?')
+    {
+      printf("Please give a value after %s.\n", argv[first]);
+      return 4;
+    }
+    else if (opt == 'b')
+    {
+      binary = 1;
+    }
+    else if (opt == 'f')
+    {
+      input = value;
+    }
+    else
+    {
+      output = value;
+    }
   }
 
-  int size = argc - 1,                          // Size to avoid repetitive calculations
-      *arr = (int *)malloc(sizeof(int) * size), // Integer array to store the numbers
-      i, j = 0;                                 // Iterators for loops
+  if ((input != NULL && first < argc) || ((binary || output) && input == NULL))
+  {
+    printf("Please give either numbers or a file with -f; -b and -o only go with -f.\n");
+    return 4;
+  }
 
-  for (i = 1; i < size + 1; i++, j++)
+  if (input != NULL)
   {
-    arr[j] = _atoi(argv[i]); // Convert from string to integer
+    arr = (int *)read_numbers(input, INT32, binary, &size, &mapped);
+    if (arr == NULL)
+    {
+      return size == -1 ? 5 : size == -2 ? 2 : size == -3 ? 3 : 6;
+    }
+  }
+  else
+  {
+    if (argc == 1) // Failsafe case if there aren't enough arguments
+    {
+      printf("Not enough arguments; please enter an array of numbers separated by a space.\n");
+      return 1;
+    }
+
+    size = argc - 1;
+    arr = (int *)malloc(sizeof(int) * size);
+    if (NULL == arr)
+    {
+      printf("Memory allocation failed.\n");
+      return 2;
+    }
+
+    for (i = 1; i < size + 1; i++, j++)
+    {
+      if (!parse_number(argv[i], INT32, arr, j)) // Convert from string to integer
+      {
+        printf("Please use only whole numbers; \"%s\" is not one.\n", argv[i]);
+        free(arr);
+        return 3;
+      }
+    }
   }
 
-  bubble(arr, size);
+  struct timespec start, end;
+  double time_used;
 
-  printf("\nResult: ");
-  for (i = 0; i < size; i++) // Display sorted array
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (size > 1)
   {
-    printf("%d ", arr[i]);
+    bubble(arr, size);
   }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  time_used = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
 
-  printf("\n");
-  return 0;
+  if (input != NULL) // Standard output may hold the sorted numbers, so report on standard error
+  {
+    fprintf(stderr, "\nTime taken: %lf seconds\n", time_used);
+    res = write_numbers(output, arr, size, INT32, binary) ? 7 : 0;
+  }
+  else
+  {
+    printf("\nTime taken: %lf seconds\n", time_used);
+
+    printf("\nResult: ");
+    for (i = 0; i < size; i++) // Display sorted array
+    {
+      printf("%d ", arr[i]);
+    }
+    printf("\n");
+  }
+
+  if (mapped >= 0)
+  {
+    unmap_file((char *)arr, mapped);
+  }
+  else
+  {
+    free(arr);
+  }
+  return res;
 }
+#endif
 
 void bubble(int *a, int n)
 {
-  clock_t start, end;
-  double cpu_time_used;
-  start = clock();
-
   int i = n - 1, sorted, temp;
   do
   {
@@ -56,27 +158,4 @@ void bubble(int *a, int n)
       }
     } while (--j);
   } while (--i && sorted);
-
-  end = clock();
-  cpu_time_used = (end - start) / CLOCKS_PER_SEC;
-
-  printf("\nTime taken: %lf seconds\n", cpu_time_used);
-}
-
-int _atoi(char *arr)
-{
-  int i,       // Iterate through the string
-      buffer,  // Buffer for the calculations later
-      res = 0; // Resulting integer
-
-  for (i = 0; arr[i] != '\0'; i++)
-  {
-    buffer = (int)arr[i] - (int)'0';
-    if (buffer >= 0)
-    {
-      res *= 10;
-      res += buffer;
-    }
-  }
-  return res;
 }
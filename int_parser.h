@@ -0,0 +1,207 @@
+/**
+ * Parses decimal integers out of text for the integer sorters and the
+ * benchmark. A number is an optional sign followed by digits, where only
+ * a plus sign is allowed for unsigned numbers, and numbers are separated by spaces, tabs or line endings; anything else is a
+ * malformed token, reported with its position instead of being read as
+ * something it is not.
+ *
+ * Digits are converted 8 at a time: 8 bytes are loaded as one 64-bit word,
+ * checked to all be digits and combined pairwise in three multiplies
+ * (SWAR, SIMD within a register). Runs of fewer than 8 digits fall back to
+ * one digit at a time.
+ */
+#ifndef INT_PARSER_H
+#define INT_PARSER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define INT_TOKEN_SHOWN 20 // Most characters of a malformed token printed
+
+/**
+ * Tells whether a byte separates numbers.
+ */
+static inline int is_int_separator(char c)
+{
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+/**
+ * Loads 8 bytes of text as a word with the first byte lowest.
+ */
+static inline uint64_t load_digits8(const char *p)
+{
+  uint64_t chunk;
+
+  memcpy(&chunk, p, sizeof(chunk));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  chunk = __builtin_bswap64(chunk);
+#endif
+  return chunk;
+}
+
+/**
+ * Tells whether all 8 bytes of a loaded word are digits: each byte must
+ * have 3 as its high nibble, and still have it with 6 added to the low one.
+ */
+static inline int is_digits8(uint64_t chunk)
+{
+  return ((chunk & 0xF0F0F0F0F0F0F0F0ULL) |
+          (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) == 0x3333333333333333ULL;
+}
+
+/**
+ * Converts a loaded word of 8 digits to its value: pairs of digits, then
+ * pairs of pairs, then the two halves are combined with one multiply each.
+ */
+static inline uint32_t convert_digits8(uint64_t chunk)
+{
+  chunk = (chunk & 0x0F0F0F0F0F0F0F0FULL) * 2561 >> 8;
+  chunk = (chunk & 0x00FF00FF00FF00FFULL) * 6553601 >> 16;
+  return (uint32_t)((chunk & 0x0000FFFF0000FFFFULL) * 42949672960001ULL >> 32);
+}
+
+/**
+ * Converts the digits from index i to len of text, of which there must be
+ * at least one, and stores their value in magnitude.
+ * Returns 1 if successful, 0 if a character is not a digit or the value
+ * does not fit in 64 bits.
+ */
+static inline int parse_digits(const char *text, long len, long i, uint64_t *magnitude)
+{
+  uint64_t value = 0;
+
+  if (i == len)
+  {
+    return 0;
+  }
+
+  for (; len - i >= 8 && is_digits8(load_digits8(text + i)); i += 8)
+  {
+    if (__builtin_mul_overflow(value, 100000000, &value) ||
+        __builtin_add_overflow(value, convert_digits8(load_digits8(text + i)), &value))
+    {
+      return 0;
+    }
+  }
+
+  for (; i < len; i++)
+  {
+    if (text[i] < '0' || text[i] > '9' ||
+        __builtin_mul_overflow(value, 10, &value) ||
+        __builtin_add_overflow(value, (uint64_t)(text[i] - '0'), &value))
+    {
+      return 0;
+    }
+  }
+
+  *magnitude = value;
+  return 1;
+}
+
+/**
+ * Converts the len characters at text, which must be exactly one integer,
+ * and stores it in value.
+ * Returns 1 if successful, 0 if the characters are not an integer or it
+ * does not fit in 64 bits.
+ */
+static inline int parse_int(const char *text, long len, int64_t *value)
+{
+  uint64_t magnitude, limit = INT64_MAX;
+  long i = 0;
+
+  if (len > 0 && (text[0] == '-' || text[0] == '+'))
+  {
+    limit += text[0] == '-'; // One more negative number than positive
+    i++;
+  }
+  if (!parse_digits(text, len, i, &magnitude) || magnitude > limit)
+  {
+    return 0;
+  }
+  *value = text[0] == '-' ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+  return 1;
+}
+
+/**
+ * Like parse_int, for an integer that cannot be negative.
+ */
+static inline int parse_uint(const char *text, long len, uint64_t *value)
+{
+  return parse_digits(text, len, len > 0 && text[0] == '+', value);
+}
+
+/**
+ * Parses every integer in the size bytes of text into values, as int64_t
+ * or, if is_unsigned is set, as uint64_t. values must have room for all of
+ * them; if it is NULL the numbers are only counted, and not checked.
+ * Returns the number of integers, or -1 if a token is not an integer that
+ * fits, with bad set to where it starts.
+ */
+static inline long parse_int_tokens(const char *text, long size, void *values, int is_unsigned, long *bad)
+{
+  long pos = 0, start, count = 0;
+  int parsed;
+
+  while (pos < size)
+  {
+    for (; pos < size && is_int_separator(text[pos]); pos++)
+      ;
+    if (pos == size)
+    {
+      break;
+    }
+
+    for (start = pos; pos < size && !is_int_separator(text[pos]); pos++)
+      ;
+    if (values != NULL)
+    {
+      parsed = is_unsigned ? parse_uint(text + start, pos - start, (uint64_t *)values + count)
+                           : parse_int(text + start, pos - start, (int64_t *)values + count);
+      if (!parsed)
+      {
+        *bad = start;
+        return -1;
+      }
+    }
+    count++;
+  }
+  return count;
+}
+
+/**
+ * Parses every integer in the size bytes of text into values, which must
+ * have room for all of them. If values is NULL the numbers are only
+ * counted, and not checked.
+ * Returns the number of integers, or -1 if a token is not an integer that
+ * fits in 64 bits, with bad set to where it starts.
+ */
+static inline long parse_ints(const char *text, long size, int64_t *values, long *bad)
+{
+  return parse_int_tokens(text, size, values, 0, bad);
+}
+
+/**
+ * Like parse_ints, for integers that cannot be negative.
+ */
+static inline long parse_uints(const char *text, long size, uint64_t *values, long *bad)
+{
+  return parse_int_tokens(text, size, values, 1, bad);
+}
+
+/**
+ * Prints the malformed token that starts at position bad of text.
+ */
+static inline void report_bad_int(const char *text, long size, long bad)
+{
+  long len;
+
+  for (len = 0; bad + len < size && !is_int_separator(text[bad + len]); len++)
+    ;
+  printf("Please use only whole numbers; \"%.*s%s\" at byte %ld is not one.\n",
+         (int)(len > INT_TOKEN_SHOWN ? INT_TOKEN_SHOWN : len), text + bad,
+         len > INT_TOKEN_SHOWN ? "..." : "", bad);
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include "SortingCodes/sorting_codes.h"
 
 #define MAX_FLIGHTS 100
 
@@ -17,7 +18,6 @@ typedef struct {
 } Subset;
 
 // Function prototypes
-int compareFlights(const void *a, const void *b); // Function to compare flights by cost
 int find(Subset subsets[], int i);               // Function to find the root of a set
 void unionSets(Subset subsets[], int x, int y);  // Function to union two sets
 void kruskalMST(Flight flights[], int numFlights, int numCities); // Kruskal's MST algorithm
@@ -44,12 +44,8 @@ int main() {
     return 0;
 }
 
-// Function to compare flights by their cost (used in sorting)
-int compareFlights(const void *a, const void *b) {
-    // TODO: Implement comparison logic for sorting flights by cost
-    Flight *flA = (Flight*) a, *flB = (Flight*) b;
-    return flA->cost - flB->cost;
-}
+// Function to sort flights by their cost, with the comparison inlined
+DEFINE_SORT(sortFlights, Flight, a->cost < b->cost)
 
 // Function to find the root of a set (with path compression)
 int find(Subset subsets[], int i) {
@@ -79,7 +75,7 @@ void unionSets(Subset subsets[], int x, int y) {
 // Function to compute the MST using Kruskal's algorithm
 void kruskalMST(Flight flights[], int numFlights, int numCities) {
     // TODO: Sort flights by cost
-    qsort(flights, numFlights, sizeof(Flight), compareFlights);
+    sortFlights(flights, numFlights);
     // TODO: Initialize subsets
     Subset subsets[numCities];
     for (int i = 0; i < numCities; i++) {
@@ -1,417 +1,1868 @@
 /**
  * Note: when using this programme, please ensure
  * the following:
- * - The file contains words separated by newlines.
- * - The words contain only letters and numbers.
+ * - The file contains words separated by newlines
+ *   (LF or CRLF).
+ * - The words contain only letters and numbers,
+ *   unless -b is given.
  * - The file does not contain any spaces.
- * - The last word in the file has only one empty
- *   line after it; no more, no less.
+ *
+ * Usage: lsd-radix-sort-strings [options] file
+ * -m: Memory-map the file instead of reading it into a buffer.
+ * -b: Allow any bytes in the words, such as punctuation and UTF-8; only
+ *     line endings separate them. Words sort byte by byte.
+ * -a: Sorting algorithm; lsd (default) pads every word to the longest
+ *     one, msd only looks as far as each word needs to be told apart,
+ *     prefix sorts 8-character key prefixes kept next to the views.
+ * -j: Number of threads. The file is split into pieces at line endings
+ *     and the threads find the words of one piece each; the words are
+ *     viewed where they are, as with -m. They are then split by their
+ *     first character and the threads sort those buckets with the chosen
+ *     algorithm.
+ * -M: Memory budget in megabytes for files that do not fit in memory.
+ *     The file is sorted a chunk at a time into runs in a temporary
+ *     directory, then the runs are merged into the output.
+ * -T: Temporary directory for -M; defaults to $TMPDIR, then /tmp.
+ * -o: Output file for the sorted words, one per line; defaults to
+ *     standard output.
+ * -i: Already sorted file to merge the words into. Only the words of
+ *     file are sorted, then both are merged line by line into the output,
+ *     which must be a different file. Not used with -M.
+ * -k: Only sort and write the first K words. Buckets that lie wholly
+ *     past the K-th word are set aside without being sorted. Not used
+ *     with -j, -M, -i, -u or -c, as the copies of a word past the K-th
+ *     one are not counted.
+ * -u: Write each distinct word once, like sort -u.
+ * -c: Write each distinct word once after the number of times it occurs,
+ *     like sort | uniq -c.
+ * -q: Quiet; only the sorted words are written, without the initial list
+ *     or headers, and the time taken goes to standard error.
+ *
+ * Compile with -pthread.
  */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+#include <stdint.h>
+#include <limits.h>
 #include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "word_tokenizer.h"
+#include "mapped_file.h"
+#include "slice_threads.h"
 
-#define ASCII_SIZE 128
-#define ASCII_NULL 0
-#define ASCII_ZERO 48
-#define ASCII_NINE 57
-#define ASCII_U_A 65
-#define ASCII_U_Z 90
-#define ASCII_L_A 97
-#define ASCII_L_Z 122
+#define BYTE_VALUES 256
+#define BUCKETS (BYTE_VALUES + 1) // One more bucket for the end of a word
+#define INSERTION_THRESHOLD 16    // Buckets smaller than this use insertion sort
+#define OUTPUT_BUFFER (1 << 22)   // Bytes gathered before each write of the output
 
-int radix_sort(char **, int);
-int resize_strs(char **, int);
-int bucket_allocation(char ***, int, int, int, int);
+// How words that occur more than once are written
+#define WRITE_ALL 0    // Every occurrence
+#define WRITE_UNIQUE 1 // Once
+#define WRITE_COUNTS 2 // Once, after its number of occurrences
+
+// Bucket of a word at position j; 0 is the end of the word, so it sorts
+// before every byte, including a null byte in the word
+#define BUCKET_AT(text, w, j) ((j) < (w).len ? (unsigned char)(text)[(w).off + (j)] + 1 : 0)
+
+// Character of a word at position j, or the null character past its end
+#define CHAR_AT(text, w, j) ((j) < (w).len ? (unsigned char)(text)[(w).off + (j)] : 0)
+
+/**
+ * Every sorting algorithm takes the text, the words, how many words there
+ * are and how many leading characters they are already known to share.
+ * Returns 0 if successful, 1 if memory allocation fails.
+ */
+typedef int (*SortFunction)(const char *, Word *, long, long);
+
+/**
+ * One thread's share of the first partition: its slice of the words and
+ * the histogram of their first characters, which the prefix sum turns
+ * into the positions the slice scatters its words to.
+ */
+typedef struct
+{
+  const char *text;
+  Word *words, *scratch;
+  long lo, hi;         // Slice of words handled by this thread
+  long count[BUCKETS]; // Histogram, then scatter positions
+} Slice;
+
+/**
+ * Buckets left to sort after the first partition, shared by the workers.
+ */
+typedef struct
+{
+  const char *text;
+  Word *words, *scratch;
+  long start[BUCKETS], size[BUCKETS];
+  int order[BUCKETS], // Buckets from largest to smallest
+      next,           // Next entry of order to hand out
+      failed;         // Set if any bucket failed to sort
+  SortFunction sort;
+  pthread_mutex_t lock;
+} BucketQueue;
+
+/**
+ * One thread's piece of the file when the words are found in parallel.
+ * The piece starts at the start of a line and ends just past a newline or
+ * at the end of the file.
+ */
+typedef struct
+{
+  const char *buffer;
+  long lo, hi, size,
+      bad;         // Position of the first byte that is not allowed
+  long word_count; // Words in the piece
+  int any_bytes,
+      res;         // Return code of scan_lines
+  Word *words;     // Where the piece's views go; NULL while counting
+} Piece;
+
+/**
+ * Where the sorted words go. Words are copied into one large buffer that
+ * is written out whenever it fills, so the output costs a few large
+ * writes however many words there are.
+ */
+typedef struct
+{
+  int fd;
+  char *buffer;
+  long used, size;
+  int failed; // Set once a write fails; later writes are dropped
+} Output;
+
+/**
+ * A sorted run of the external sort: its temporary file and the line it
+ * is currently offering to the merge.
+ */
+typedef struct
+{
+  FILE *fp;
+  char *line;
+  size_t cap;
+  ssize_t len; // Length of line without the newline, or -1 once the run is empty
+} Run;
+
+/**
+ * A view together with the 8 characters of its word from the current
+ * depth, packed big-endian so comparing keys compares the characters.
+ */
+typedef struct
+{
+  uint64_t key;
+  Word word;
+} KeyedWord;
+
+int sort_words(const char *, Word *, long, SortFunction, int, long, FILE *);
+int radix_sort(const char *, Word *, long, long);
+int msd_sort(const char *, Word *, long, long);
+int partial_sort(const char *, Word *, long, long, long);
+int count_buckets(const char *, Word *, long, long *, long *);
+void permute_buckets(const char *, Word *, long *, long *, long);
+int prefix_sort(const char *, Word *, long, long);
+uint64_t load_prefix(const char *, Word, long);
+int parallel_sort(const char *, Word *, long, SortFunction, int);
+void *histogram_slice(void *);
+void *scatter_slice(void *);
+int parallel_tokenize(const char *, long, int, Word **, long *, int);
+void *scan_piece(void *);
+void *sort_buckets(void *);
+void insertion_sort(const char *, Word *, long, long);
+int compare_words(const char *, Word, Word, long);
+char *read_file(const char *, long *);
+void release_file(char *, long, int);
+void release_arena(WordArena *, long, int);
+void print_words(const char *, Word *, long);
+int open_output(Output *, const char *, long);
+void write_bytes(Output *, const char *, long);
+void write_words(Output *, const char *, Word *, long, int);
+void write_entry(Output *, const char *, long, long, int);
+int merge_sorted(const char *, Output *, const char *, Word *, long, int);
+int compare_bytes(const char *, long, const char *, long);
+int flush_output(Output *);
+int close_output(Output *);
+int write_all(int, const char *, long);
+int external_sort(const char *, Output *, const char *, long, SortFunction, int, int, int);
+long scratch_per_word(SortFunction, int);
+int write_run(const char *, Word *, long, const char *, long, char ***, int *, int);
+int merge_runs(char **, int, Output *, long, int);
+int line_less(Run *, int, int, int);
+void replay(Run *, int *, int, int);
+
+#ifndef SORT_BENCHMARK
+/**
+ * Return codes:
+ * 0: Success
+ * 1: Not enough arguments
+ * 2: Too many arguments
+ * 3: Error opening file
+ * 4: Memory allocation failed
+ * 5: File format error
+ * 6: Unknown option
+ * 7: Error opening or writing a temporary or output file
+ */
+int main(int argc, char **argv)
+{
+  int opt, res,
+      use_mmap = 0,   // Map the file instead of reading it
+      any_bytes = 0,  // Allow any bytes in the words
+      threads = 1,    // Threads used for sorting
+      quiet = 0,      // Only write the sorted words
+      repeats = WRITE_ALL,
+      bad_option = 0; // Set if an option or its value is not recognised
+  long budget = 0,    // Memory budget in bytes; 0 sorts in memory
+      top = 0;        // Number of words to sort and write; 0 for all
+  const char *output = NULL, // Output file; NULL for standard output
+      *sorted = NULL,        // Sorted file to merge the words into
+      *tmpdir = getenv("TMPDIR");
+  char *end; // End of a number read from an option
+  struct stat sorted_st, output_st;
+  SortFunction sort = radix_sort;
+  Output out;
+
+  while ((opt = getopt(argc, argv, "mba:j:M:T:o:i:k:quc")) != -1)
+  {
+    switch (opt)
+    {
+    case 'm':
+      use_mmap = 1;
+      break;
+    case 'b':
+      any_bytes = 1;
+      break;
+    case 'a':
+      if (strcmp(optarg, "lsd") == 0)
+      {
+        sort = radix_sort;
+      }
+      else if (strcmp(optarg, "msd") == 0)
+      {
+        sort = msd_sort;
+      }
+      else if (strcmp(optarg, "prefix") == 0)
+      {
+        sort = prefix_sort;
+      }
+      else
+      {
+        bad_option = 1;
+      }
+      break;
+    case 'j':
+      threads = atoi(optarg);
+      bad_option |= threads < 1;
+      break;
+    case 'M':
+      budget = strtol(optarg, &end, 10);
+      if (end == optarg || *end != '\0' || budget < 1 || budget > LONG_MAX / (1024 * 1024))
+      {
+        bad_option = 1;
+      }
+      else
+      {
+        budget *= 1024 * 1024;
+      }
+      break;
+    case 'T':
+      tmpdir = optarg;
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    case 'i':
+      sorted = optarg;
+      break;
+    case 'k':
+      top = atol(optarg);
+      bad_option |= top < 1;
+      break;
+    case 'q':
+      quiet = 1;
+      break;
+    case 'u':
+      repeats = repeats == WRITE_COUNTS ? WRITE_COUNTS : WRITE_UNIQUE;
+      break;
+    case 'c':
+      repeats = WRITE_COUNTS;
+      break;
+    default:
+      bad_option = 1;
+    }
+  }
+
+  if (bad_option || (sorted && budget > 0) || (top > 0 && (threads > 1 || budget > 0 || sorted || repeats != WRITE_ALL)))
+  {
+    printf("Usage: %s [-m] [-b] [-q] [-u | -c] [-a lsd|msd|prefix] [-j threads | -k count] [-M megabytes [-T tmpdir] | -i sorted] [-o output] file\n", argv[0]);
+    return 6;
+  }
+  if (optind == argc) // Failsafe case if there aren't enough arguments
+  {
+    printf("Not enough arguments; please enter a file path.\n");
+    return 1;
+  }
+  if (argc - optind > 1) // Failsafe case if there are too many arguments
+  {
+    printf("Too many arguments; please enter only one file name.\n");
+    return 2;
+  }
+
+  // Writing the output would truncate the file being merged from
+  if (sorted && output && stat(sorted, &sorted_st) == 0 && stat(output, &output_st) == 0 &&
+      sorted_st.st_dev == output_st.st_dev && sorted_st.st_ino == output_st.st_ino)
+  {
+    printf("Please write the output to a different file than the sorted file.\n");
+    return 7;
+  }
+
+  if (budget > 0)
+  {
+    // The output buffer comes out of the budget, like the rest of the merge
+    res = open_output(&out, output, budget / 2 < OUTPUT_BUFFER ? budget / 2 : OUTPUT_BUFFER);
+    if (res == 0)
+    {
+      res = external_sort(argv[optind], &out, tmpdir ? tmpdir : "/tmp", budget, sort, threads, any_bytes, repeats);
+      res = close_output(&out) && res == 0 ? 7 : res;
+    }
+    return res;
+  }
+
+  long file_size;  // Variable to store the file size
+  WordArena arena; // Words of the file; the slab is the mapping with -m
+  char *buffer;    // File contents, either read or mapped
+
+  buffer = use_mmap ? map_file(argv[optind], &file_size, 0) : read_file(argv[optind], &file_size);
+  if (buffer == NULL)
+  {
+    return file_size < 0 ? 3 : 4;
+  }
+
+  if (threads > 1) // Packing the words would be a serial pass, so they are viewed where they are
+  {
+    arena.slab = buffer;
+    arena.words = NULL;
+    res = parallel_tokenize(buffer, file_size, any_bytes, &arena.words, &arena.word_count, threads);
+  }
+  else if (use_mmap) // The mapping is read-only, so the words are viewed where they are
+  {
+    arena.slab = buffer;
+    res = tokenize_words(buffer, file_size, any_bytes, &arena.words, &arena.word_count);
+  }
+  else
+  {
+    res = load_arena(&arena, buffer, file_size, any_bytes);
+  }
+  if (res)
+  {
+    if (use_mmap || threads > 1)
+    {
+      release_file(buffer, file_size, use_mmap);
+    }
+    return res;
+  }
+
+  if (!quiet)
+  {
+    printf("\nInitial list of words:\n");
+    print_words(arena.slab, arena.words, arena.word_count);
+  }
+
+  // Standard output may hold only the sorted words, so report on standard error
+  if (sort_words(arena.slab, arena.words, arena.word_count, sort, threads, top, quiet ? stderr : stdout))
+  {
+    printf("Memory allocation failed.\n");
+    release_arena(&arena, file_size, use_mmap);
+    return 4;
+  }
+  if (top > 0 && top < arena.word_count) // The rest are not in order
+  {
+    arena.word_count = top;
+  }
+
+  res = open_output(&out, output, OUTPUT_BUFFER);
+  if (res == 0)
+  {
+    if (!quiet && output == NULL)
+    {
+      printf("\nSorted list of words:\n");
+    }
+    if (sorted)
+    {
+      res = merge_sorted(sorted, &out, arena.slab, arena.words, arena.word_count, repeats);
+    }
+    else
+    {
+      write_words(&out, arena.slab, arena.words, arena.word_count, repeats);
+    }
+    res = close_output(&out) && res == 0 ? 7 : res;
+  }
+
+  release_arena(&arena, file_size, use_mmap);
+
+  return res;
+}
+#endif
+
+/**
+ * Reads the whole file into a new buffer.
+ * Returns NULL on failure; size is set to -1 if the file could not be opened.
+ */
+char *read_file(const char *path, long *size)
+{
+  FILE *fp;
+  char *buffer;
+
+  fp = fopen(path, "rb");
+  if (fp == NULL)
+  {
+    printf("Error opening file.\n");
+    *size = -1;
+    return NULL;
+  }
+
+  // Find how large the file is
+  fseek(fp, 0L, SEEK_END);
+  *size = ftell(fp);
+  fseek(fp, 0L, SEEK_SET);
+
+  buffer = (char *)malloc(sizeof(char) * (*size + 1));
+  if (NULL == buffer)
+  {
+    printf("Memory allocation failed.\n");
+    fclose(fp);
+    return NULL;
+  }
+
+  *size = fread(buffer, 1, *size, fp);
+  fclose(fp);
+
+  return buffer;
+}
+
+/**
+ * Frees a buffer from read_file or unmaps one from map_file.
+ */
+void release_file(char *text, long size, int mapped)
+{
+  if (mapped)
+  {
+    unmap_file(text, size);
+  }
+  else
+  {
+    free(text);
+  }
+}
+
+/**
+ * Frees an arena whose slab may be a mapping from map_file.
+ */
+void release_arena(WordArena *arena, long size, int mapped)
+{
+  if (mapped)
+  {
+    release_file(arena->slab, size, mapped);
+    arena->slab = NULL;
+  }
+  free_arena(arena);
+}
+
+/**
+ * Writes the words separated by spaces, straight from the file contents.
+ */
+void print_words(const char *text, Word *words, long word_count)
+{
+  long i;
+
+  for (i = 0; i < word_count; i++)
+  {
+    fwrite(text + words[i].off, sizeof(char), words[i].len, stdout);
+    putchar(' ');
+  }
+  putchar('\n');
+}
+
+/**
+ * Opens the output file, or standard output if path is NULL, with a buffer
+ * of size bytes.
+ * Returns 0 if successful, 4 if memory allocation fails and 7 if the file
+ * cannot be opened.
+ */
+int open_output(Output *out, const char *path, long size)
+{
+  out->fd = path ? open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666) : STDOUT_FILENO;
+  if (out->fd < 0)
+  {
+    printf("Error opening output file.\n");
+    return 7;
+  }
+
+  out->buffer = (char *)malloc(sizeof(char) * size);
+  if (out->buffer == NULL)
+  {
+    printf("Memory allocation failed.\n");
+    if (path)
+    {
+      close(out->fd);
+    }
+    return 4;
+  }
+
+  out->used = 0;
+  out->size = size;
+  out->failed = 0;
+  return 0;
+}
+
+/**
+ * Adds len bytes to the output, writing the buffer out first if they do
+ * not fit. Anything larger than the whole buffer is written directly.
+ */
+void write_bytes(Output *out, const char *bytes, long len)
+{
+  if (out->used + len > out->size)
+  {
+    flush_output(out);
+    if (len > out->size)
+    {
+      out->failed |= write_all(out->fd, bytes, len);
+      return;
+    }
+  }
+  memcpy(out->buffer + out->used, bytes, len);
+  out->used += len;
+}
+
+/**
+ * Writes sorted words to the output, one per line. Equal words are next to
+ * each other, so unless repeats is WRITE_ALL each run of them is collapsed
+ * into one line as it is written.
+ */
+void write_words(Output *out, const char *text, Word *words, long word_count, int repeats)
+{
+  long i, j;
+
+  for (i = 0; i < word_count; i = j)
+  {
+    for (j = i + 1; repeats != WRITE_ALL && j < word_count && compare_words(text, words[i], words[j], 0) == 0; j++)
+      ;
+    write_entry(out, text + words[i].off, words[i].len, j - i, repeats);
+  }
+}
+
+/**
+ * Writes one line of output: the word, after its count with WRITE_COUNTS.
+ */
+void write_entry(Output *out, const char *word, long len, long count, int repeats)
+{
+  char number[32];
+
+  if (repeats == WRITE_COUNTS)
+  {
+    write_bytes(out, number, snprintf(number, sizeof(number), "%7ld ", count));
+  }
+  write_bytes(out, word, len);
+  write_bytes(out, "\n", 1);
+}
+
+/**
+ * Writes out whatever is in the buffer. Anything printf left in the
+ * standard output buffer goes first, so headers stay in front of the
+ * words they belong to.
+ * Returns 0 if everything written so far made it out, 1 otherwise.
+ */
+int flush_output(Output *out)
+{
+  if (out->fd == STDOUT_FILENO)
+  {
+    fflush(stdout);
+  }
+  out->failed |= write_all(out->fd, out->buffer, out->used);
+  out->used = 0;
+  return out->failed;
+}
+
+/**
+ * Flushes the output and closes it, unless it is standard output.
+ * Returns 0 if successful, 1 if any write failed; the error is printed.
+ */
+int close_output(Output *out)
+{
+  int res = flush_output(out);
+
+  if (out->fd != STDOUT_FILENO && close(out->fd) != 0)
+  {
+    res = 1;
+  }
+  free(out->buffer);
+  out->buffer = NULL;
+
+  if (res)
+  {
+    printf("Error writing output file.\n");
+  }
+  return res;
+}
+
+/**
+ * Writes len bytes to fd, picking up after short or interrupted writes.
+ * Returns 0 if successful, 1 if the write fails.
+ */
+int write_all(int fd, const char *bytes, long len)
+{
+  ssize_t written;
+
+  while (len > 0)
+  {
+    written = write(fd, bytes, len);
+    if (written < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (written <= 0)
+    {
+      return 1;
+    }
+    bytes += written;
+    len -= written;
+  }
+  return 0;
+}
+
+/**
+ * Merges sorted words into the sorted file at path, writing the result to
+ * out. The file is mapped and read once from start to end, a line at a
+ * time, so the cost is one sequential pass over it however few words are
+ * added. Lines may end in LF or CRLF and empty lines are skipped; on ties
+ * the file's line comes first. Repeats are collapsed across both inputs.
+ * Returns 0 if successful, 3 if the file cannot be opened, 4 if memory
+ * allocation fails and 5 if the file is not sorted.
+ */
+int merge_sorted(const char *path, Output *out, const char *text, Word *words, long word_count, int repeats)
+{
+  const char *file, *end, // The mapped file and the end of its current line
+      *line = NULL,       // Current line of the file, or NULL once it runs out
+      *previous = NULL,   // Line of the file before it
+      *pending = NULL,    // Line held back while its repeats are counted
+      *next;              // Line written next
+  long size, pos = 0, i = 0,
+      line_len = 0, previous_len = 0, pending_len = 0, next_len,
+      count = 0;
+  int res = 0;
+
+  file = map_file(path, &size, 0);
+  if (file == NULL)
+  {
+    return size < 0 ? 3 : 4;
+  }
+
+  for (;;)
+  {
+    // Find the next line of the file that is not empty
+    while (line == NULL && pos < size)
+    {
+      end = (const char *)memchr(file + pos, '\n', size - pos);
+      end = end ? end : file + size;
+      line_len = end - (file + pos);
+      if (line_len > 0 && end[-1] == '\r')
+      {
+        line_len--;
+      }
+      if (line_len > 0)
+      {
+        line = file + pos;
+      }
+      pos = end - file + 1;
+    }
+
+    if (line != NULL && (i == word_count || compare_bytes(line, line_len, text + words[i].off, words[i].len) <= 0))
+    {
+      next = line;
+      next_len = line_len;
+      line = NULL;
+      if (previous != NULL && compare_bytes(previous, previous_len, next, next_len) > 0)
+      {
+        printf("The file %s is not sorted (byte %ld).\n", path, (long)(next - file));
+        res = 5;
+        break;
+      }
+      previous = next;
+      previous_len = next_len;
+    }
+    else if (i < word_count)
+    {
+      next = text + words[i].off;
+      next_len = words[i].len;
+      i++;
+    }
+    else
+    {
+      break;
+    }
+
+    if (repeats == WRITE_ALL)
+    {
+      write_entry(out, next, next_len, 1, repeats);
+    }
+    else if (count > 0 && compare_bytes(pending, pending_len, next, next_len) == 0)
+    {
+      count++;
+    }
+    else
+    {
+      if (count > 0)
+      {
+        write_entry(out, pending, pending_len, count, repeats);
+      }
+      count = 1;
+    }
+    pending = next;
+    pending_len = next_len;
+  }
+
+  if (count > 0 && res == 0)
+  {
+    write_entry(out, pending, pending_len, count, repeats);
+  }
+
+  release_file((char *)file, size, 1);
+  return res;
+}
+
+/**
+ * Compares two strings of bytes like strcmp, the shorter first on a tie.
+ */
+int compare_bytes(const char *a, long a_len, const char *b, long b_len)
+{
+  int res = memcmp(a, b, a_len < b_len ? a_len : b_len);
+
+  if (res == 0)
+  {
+    res = (a_len > b_len) - (a_len < b_len);
+  }
+  return res;
+}
+
+/**
+ * Sorts the words with the given algorithm and reports how long it took
+ * on report. If top is between 0 and word_count, only the first top words
+ * are put in order, with partial_sort.
+ * Returns 0 if successful, 1 if memory allocation fails.
+ */
+int sort_words(const char *text, Word *words, long word_count, SortFunction sort, int threads, long top, FILE *report)
+{
+  struct timespec start, end;
+  double time_used;
+  int res;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  if (top > 0 && top < word_count)
+  {
+    res = partial_sort(text, words, word_count, 0, top);
+  }
+  else if (threads > 1)
+  {
+    res = parallel_sort(text, words, word_count, sort, threads);
+  }
+  else
+  {
+    res = sort(text, words, word_count, 0);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  time_used = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  fprintf(report, "\nTime taken: %lf seconds\n", time_used);
+
+  return res;
+}
+
+/**
+ * Sorts an array of words using the LSD radix sort algorithm.
+ * Every pass is a counting sort on one character position: one histogram,
+ * one prefix sum, then the word views are scattered into a scratch array.
+ * Only views move, so the extra memory is a single array of word_count
+ * views no matter how many buckets are in use. Words that end before the
+ * current position go in a bucket of their own ahead of every byte, and
+ * positions where every word has the same byte are skipped.
+ * Returns 0 if successful, 1 if memory allocation fails.
+ */
+int radix_sort(const char *text, Word *words, long word_count, long depth)
+{
+  if (word_count < 2) // Nothing to sort
+  {
+    return 0;
+  }
+
+  Word *src = words, // Words ordered by the previous pass
+      *dst,          // Words ordered by the current pass
+      *temp;         // Used to swap src and dst
+  long i, j,         // Iterators
+      total, c,      // Running sum and scratch for the prefix sum
+      character_count = 0,
+      count[BUCKETS]; // Histogram, then starting index of each bucket
+
+  // Find the size of the longest word
+  for (i = 0; i < word_count; i++)
+  {
+    if (words[i].len > character_count)
+    {
+      character_count = words[i].len;
+    }
+  }
+
+  dst = (Word *)malloc(sizeof(Word) * word_count);
+  if (dst == NULL)
+  {
+    return 1; // Memory allocation failed, return 1 to indicate failure
+  }
+
+  // Begin LSD radix sort; the first depth characters are already in order
+  for (j = character_count - 1; j >= depth; j--)
+  {
+    memset(count, 0, sizeof(count));
+    for (i = 0; i < word_count; i++)
+    {
+      count[BUCKET_AT(text, src[i], j)]++;
+    }
+
+    if (count[BUCKET_AT(text, src[0], j)] == word_count) // Every word has the same byte here
+    {
+      continue;
+    }
+
+    // Turn the counts into the index where each bucket starts
+    total = 0;
+    for (i = 0; i < BUCKETS; i++)
+    {
+      c = count[i];
+      count[i] = total;
+      total += c;
+    }
+
+    // Place each word in the appropriate bucket, keeping the previous order
+    for (i = 0; i < word_count; i++)
+    {
+      dst[count[BUCKET_AT(text, src[i], j)]++] = src[i];
+    }
+
+    temp = src;
+    src = dst;
+    dst = temp;
+  }
+
+  // After an odd number of passes the result is in the scratch array
+  if (src != words)
+  {
+    memcpy(words, src, sizeof(Word) * word_count);
+    dst = src;
+  }
+  free(dst);
+
+  return 0;
+}
+
+/**
+ * Sorts an array of words using the MSD radix sort algorithm, permuting
+ * the views in place (American flag sort). Words are never padded: the end
+ * of a word is its own bucket, so each word is only read as far as it takes
+ * to tell it apart from the others. Only the smaller buckets are sorted by
+ * recursion; the largest is sorted by the same loop, so every call holds at
+ * most half the words of its caller and the stack stays within log2(n)
+ * frames however long the prefixes the words share.
+ * Returns 0; the sort needs no extra memory beyond the stack.
+ */
+int msd_sort(const char *text, Word *words, long n, long depth)
+{
+  long count[BUCKETS], // Bucket sizes
+      end[BUCKETS];    // One past the last slot of each bucket
+  int b, largest;
+
+  while (n >= INSERTION_THRESHOLD)
+  {
+    if (count_buckets(text, words, n, &depth, count))
+    {
+      return 0;
+    }
+    permute_buckets(text, words, count, end, depth);
+
+    // Words in bucket 0 have ended, so they are all equal; sort the rest
+    for (largest = 1, b = 2; b < BUCKETS; b++)
+    {
+      if (count[b] > count[largest])
+      {
+        largest = b;
+      }
+    }
+    for (b = 1; b < BUCKETS; b++)
+    {
+      if (b != largest && count[b] > 1)
+      {
+        msd_sort(text, words + end[b] - count[b], count[b], depth + 1);
+      }
+    }
+
+    words += end[largest] - count[largest];
+    n = count[largest];
+    depth++;
+  }
+
+  insertion_sort(text, words, n, depth);
+  return 0;
+}
+
+/**
+ * Puts the first k words in order, like msd_sort, and leaves the rest
+ * after them in any order. Only the buckets up to the one holding the k-th
+ * word are kept: the words of later buckets are swapped to the back in one
+ * pass and never looked at again. Buckets before the k-th word's are
+ * sorted in full and its own bucket is sorted the same way, partially, by
+ * the next round of the loop rather than by recursion.
+ * Returns 0; like msd_sort, it needs no extra memory.
+ */
+int partial_sort(const char *text, Word *words, long n, long depth, long k)
+{
+  long count[BUCKETS], end[BUCKETS],
+      kept, // Words in the buckets that are kept
+      i, j;
+  int b, last;
+  Word temp;
+
+  for (;;)
+  {
+    if (k >= n)
+    {
+      return msd_sort(text, words, n, depth);
+    }
+    if (n < INSERTION_THRESHOLD)
+    {
+      insertion_sort(text, words, n, depth);
+      return 0;
+    }
+
+    if (count_buckets(text, words, n, &depth, count))
+    {
+      return 0;
+    }
+
+    // Find the bucket of the k-th word
+    for (kept = 0, last = 0; kept + count[last] < k; last++)
+    {
+      kept += count[last];
+    }
+    kept += count[last];
+
+    // Move the words of the kept buckets to the front
+    for (i = 0, j = n; i < kept; i++)
+    {
+      if (BUCKET_AT(text, words[i], depth) > last)
+      {
+        do
+        {
+          j--;
+        } while (BUCKET_AT(text, words[j], depth) > last);
+        temp = words[i];
+        words[i] = words[j];
+        words[j] = temp;
+      }
+    }
+
+    for (b = last + 1; b < BUCKETS; b++)
+    {
+      count[b] = 0;
+    }
+    permute_buckets(text, words, count, end, depth);
+
+    for (b = 1; b < last; b++)
+    {
+      if (count[b] > 1)
+      {
+        msd_sort(text, words + end[b] - count[b], count[b], depth + 1);
+      }
+    }
+    if (last == 0 || count[last] < 2)
+    {
+      return 0;
+    }
+
+    k -= end[last] - count[last];
+    words += end[last] - count[last];
+    n = count[last];
+    depth++;
+  }
+}
+
+/**
+ * Counts how many words fall in each bucket at position depth, moving
+ * depth past positions where every word has the same byte.
+ * Returns 1 if every word ended before a position that tells them apart,
+ * so they are all equal, 0 otherwise.
+ */
+int count_buckets(const char *text, Word *words, long n, long *depth, long *count)
+{
+  long i;
+  int b;
+
+  for (;;)
+  {
+    memset(count, 0, sizeof(long) * BUCKETS);
+    for (i = 0; i < n; i++)
+    {
+      count[BUCKET_AT(text, words[i], *depth)]++;
+    }
+
+    b = BUCKET_AT(text, words[0], *depth);
+    if (count[b] != n)
+    {
+      return 0;
+    }
+    if (b == 0)
+    {
+      return 1;
+    }
+    (*depth)++;
+  }
+}
+
+/**
+ * Moves every word into its bucket at position depth in place (American
+ * flag sort), following cycles of misplaced words. count holds the size
+ * of each bucket; end is filled with one past the last slot of each.
+ */
+void permute_buckets(const char *text, Word *words, long *count, long *end, long depth)
+{
+  long next[BUCKETS], // Next unfilled slot of each bucket
+      total = 0;
+  int b, c;
+  Word w, temp;
+
+  for (b = 0; b < BUCKETS; b++)
+  {
+    next[b] = total;
+    total += count[b];
+    end[b] = total;
+  }
+
+  for (b = 0; b < BUCKETS; b++)
+  {
+    while (next[b] < end[b])
+    {
+      w = words[next[b]];
+      c = BUCKET_AT(text, w, depth);
+      while (c != b)
+      {
+        temp = words[next[c]];
+        words[next[c]++] = w;
+        w = temp;
+        c = BUCKET_AT(text, w, depth);
+      }
+      words[next[b]++] = w;
+    }
+  }
+}
+
+/**
+ * Sorts an array of words by cached key prefixes. The next 8 characters of
+ * every word are packed into an integer kept next to its view, and an LSD
+ * radix sort orders these pairs a byte of the key at a time, so the passes
+ * read one array sequentially instead of following every view into the
+ * text. Key bytes that are the same for every word are skipped. Words with
+ * equal keys that go on past them are sorted by the next 8 characters;
+ * small groups of them are compared in full instead. Like msd_sort, only
+ * the smaller groups are sorted by recursion and the largest by the loop,
+ * so the stack stays within log2(n) frames.
+ * Returns 0 if successful, 1 if memory allocation fails.
+ */
+int prefix_sort(const char *text, Word *words, long n, long depth)
+{
+  KeyedWord *src, *dst, *temp;
+  long count[8][256], // Histogram of every key byte, from the lowest
+      i, j, total, c, group,
+      next_at, next_n; // Largest group past its keys, left to the loop
+  int k,
+      longer,  // Whether a word in the group goes past its key
+      shorter, // Whether a word in the group ends inside its key
+      lengths, // Whether the words in the group differ in length
+      res = 0;
+
+  while (n >= INSERTION_THRESHOLD)
+  {
+    src = (KeyedWord *)malloc(sizeof(KeyedWord) * n);
+    dst = (KeyedWord *)malloc(sizeof(KeyedWord) * n);
+    if (src == NULL || dst == NULL)
+    {
+      free(src);
+      free(dst);
+      return 1;
+    }
+
+    // Load the keys and count all of their bytes in one pass
+    memset(count, 0, sizeof(count));
+    for (i = 0; i < n; i++)
+    {
+      src[i].word = words[i];
+      src[i].key = load_prefix(text, words[i], depth);
+      for (k = 0; k < 8; k++)
+      {
+        count[k][(src[i].key >> (8 * k)) & 0xFF]++;
+      }
+    }
+
+    for (k = 0; k < 8; k++)
+    {
+      if (count[k][(src[0].key >> (8 * k)) & 0xFF] == n) // Every key has this byte
+      {
+        continue;
+      }
+
+      total = 0;
+      for (j = 0; j < 256; j++)
+      {
+        c = count[k][j];
+        count[k][j] = total;
+        total += c;
+      }
+      for (i = 0; i < n; i++)
+      {
+        dst[count[k][(src[i].key >> (8 * k)) & 0xFF]++] = src[i];
+      }
+
+      temp = src;
+      src = dst;
+      dst = temp;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+      words[i] = src[i].word;
+    }
+
+    // Sort each group of equal keys by the characters after them
+    next_at = next_n = 0;
+    for (i = 0; i < n && res == 0; i = j)
+    {
+      longer = shorter = lengths = 0;
+      for (j = i; j < n && src[j].key == src[i].key; j++)
+      {
+        longer |= src[j].word.len > depth + 8;
+        shorter |= src[j].word.len < depth + 8;
+        lengths |= src[j].word.len != src[i].word.len;
+      }
+
+      group = j - i;
+      if (group < 2)
+      {
+        continue;
+      }
+
+      // Keys only tell words apart as far as they go. Words that end inside
+      // their key can only share it with other lengths if the words hold null
+      // bytes ("a" and "a\0"), so those rare groups are sorted in full.
+      if (shorter && lengths)
+      {
+        msd_sort(text, words + i, group, depth);
+      }
+      else if (longer && group > next_n) // The smaller of the two is sorted now
+      {
+        res = next_n > 1 && prefix_sort(text, words + next_at, next_n, depth + 8);
+        next_at = i;
+        next_n = group;
+      }
+      else if (longer)
+      {
+        res = prefix_sort(text, words + i, group, depth + 8);
+      }
+    }
+
+    free(src);
+    free(dst);
+    if (res)
+    {
+      return 1;
+    }
+
+    words += next_at;
+    n = next_n;
+    depth += 8;
+  }
+
+  insertion_sort(text, words, n, depth);
+  return 0;
+}
 
 /**
- * Return codes:
- * 0: Success
- * 1: Not enough arguments
- * 2: Too many arguments
- * 3: Error opening file
- * 4: Memory allocation failed
- * 5: File format error
+ * Packs the 8 characters of a word from position depth into an integer,
+ * first character in the highest byte, with null characters past its end.
  */
-int main(int argc, char **argv)
+uint64_t load_prefix(const char *text, Word w, long depth)
 {
-  if (argc == 1) // Failsafe case if there aren't enough arguments
+  uint64_t key = 0;
+  long i;
+
+  if (w.len - depth >= 8)
   {
-    printf("Not enough arguments; please enter a file path.\n");
-    return 1;
+    memcpy(&key, text + w.off + depth, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    key = __builtin_bswap64(key);
+#endif
+    return key;
   }
-  if (argc > 2) // Failsafe case if there are too many arguments
+
+  for (i = depth; i < depth + 8; i++)
   {
-    printf("Too many arguments; please enter only one file name.\n");
-    return 2;
+    key = key << 8 | CHAR_AT(text, w, i);
   }
+  return key;
+}
 
-  long file_size,          // Variable to store the file size
-      i, j;                // Loop variables
-  int character_count = 0, // Variable to store the number of characters in a word
-      word_count = 0,      // Store the number of words to allocate space
-      word_i = 0;          // Iterator for the array of words
-  FILE *fp;                // File pointer
-  char **strs,             // Array of words
-      *buffer;             // Buffer to store the file contents
+/**
+ * Sorts the words on several threads. Each thread counts the first
+ * characters of its slice, a prefix sum over all the histograms gives
+ * every thread the positions its words go to, and the threads scatter
+ * their slices at once. The buckets no longer depend on each other, so
+ * the threads then take them one at a time, largest first, and sort them
+ * with the chosen algorithm. Equal words are equal bytes, so the result
+ * is the same as the serial sort's.
+ * Returns 0 if successful, 1 if memory allocation fails.
+ */
+int parallel_sort(const char *text, Word *words, long word_count, SortFunction sort, int threads)
+{
+  Slice *slices;
+  BucketQueue queue;
+  int t, b, i, j;
 
-  fp = fopen(argv[1], "rb");
-  if (fp == NULL)
+  if (word_count < (long)threads * INSERTION_THRESHOLD) // Not worth splitting
   {
-    printf("Error opening file.\n");
-    fclose(fp);
-    return 3;
+    return sort(text, words, word_count, 0);
   }
 
-  // Find how large the file is
-  fseek(fp, 0L, SEEK_END);
-  file_size = ftell(fp);
-  fseek(fp, 0L, SEEK_SET);
-
-  buffer = (char *)malloc(sizeof(char) * file_size);
+  slices = (Slice *)calloc(threads, sizeof(Slice));
+  queue.scratch = (Word *)malloc(sizeof(Word) * word_count);
+  if (slices == NULL || queue.scratch == NULL)
+  {
+    free(slices);
+    free(queue.scratch);
+    return 1;
+  }
 
-  if (NULL == buffer)
+  for (t = 0; t < threads; t++)
   {
-    printf("Memory allocation failed.\n");
-    return 4;
+    slices[t].text = text;
+    slices[t].words = words;
+    slices[t].scratch = queue.scratch;
+    slices[t].lo = word_count * t / threads;
+    slices[t].hi = word_count * (t + 1) / threads;
   }
+  run_threads(histogram_slice, slices, sizeof(Slice), threads);
 
-  fread(buffer, 1, file_size, fp);
-  fclose(fp);
+  offset_slices(slices[0].count, sizeof(Slice), threads, BUCKETS, queue.start);
+  for (b = 0; b < BUCKETS; b++)
+  {
+    queue.size[b] = (b + 1 < BUCKETS ? queue.start[b + 1] : word_count) - queue.start[b];
+  }
+  run_threads(scatter_slice, slices, sizeof(Slice), threads);
+  free(slices);
 
-  // Count the number of words in the file.
-  // This does not help optimise performance, but it optimises storage.
-  for (i = 0; i < file_size; i++)
+  // Hand out the largest buckets first so no thread is left with one at the end
+  for (i = 0; i < BUCKETS; i++)
   {
-    if (buffer[i] == '\n')
+    b = i;
+    for (j = i; j > 0 && queue.size[queue.order[j - 1]] < queue.size[b]; j--)
     {
-      continue;
-    }
-    if (buffer[i] == '\r') // Skip carriage return characters
-    {
-      word_count++;
-    }
-    else if (buffer[i] == ' ')
-    {
-      printf("Please format the file to contain words only separated by newlines.\n");
-      free(buffer);
-      return 5;
-    }
-    else if (!isalnum(buffer[i]))
-    {
-      printf("Please use only numbers and letters in the words.\n");
-      free(buffer);
-      return 5;
+      queue.order[j] = queue.order[j - 1];
     }
+    queue.order[j] = b;
+  }
+
+  queue.text = text;
+  queue.words = words;
+  queue.next = 0;
+  queue.failed = 0;
+  queue.sort = sort;
+  pthread_mutex_init(&queue.lock, NULL);
+  run_threads(sort_buckets, &queue, 0, threads);
+  pthread_mutex_destroy(&queue.lock);
+
+  free(queue.scratch);
+  return queue.failed;
+}
+
+void *histogram_slice(void *arg)
+{
+  Slice *s = (Slice *)arg;
+  long i;
+
+  for (i = s->lo; i < s->hi; i++)
+  {
+    s->count[BUCKET_AT(s->text, s->words[i], 0)]++;
+  }
+  return NULL;
+}
+
+void *scatter_slice(void *arg)
+{
+  Slice *s = (Slice *)arg;
+  long i;
+
+  for (i = s->lo; i < s->hi; i++)
+  {
+    s->scratch[s->count[BUCKET_AT(s->text, s->words[i], 0)]++] = s->words[i];
   }
+  return NULL;
+}
 
-  strs = (char **)malloc(sizeof(char *) * word_count);
+/**
+ * Builds the array of views for the words in buffer on several threads,
+ * like tokenize_words. The buffer is cut into one piece per thread at
+ * line endings. The threads count the words of their pieces, a prefix sum
+ * of the counts gives each piece its slice of one array sized to fit, and
+ * the threads then fill their slices. If *words is not NULL, it must have
+ * room for every word and is filled instead of a new array.
+ * Returns 0 if successful, 4 if memory allocation fails and 5 if the
+ * buffer holds anything other than words and line endings. On failure
+ * an array allocated here is freed.
+ */
+int parallel_tokenize(const char *buffer, long size, int any_bytes, Word **words, long *word_count, int threads)
+{
+  Piece *pieces;
+  const char *newline;
+  long cut = 0, total = 0;
+  int t, first_bad = -1,
+      given = *words != NULL; // Filled in place rather than allocated
 
-  if (strs == NULL)
+  pieces = (Piece *)calloc(threads, sizeof(Piece));
+  if (pieces == NULL)
   {
     printf("Memory allocation failed.\n");
     return 4;
   }
 
-  for (i = 0; i < file_size; i++) // Store the words in the array of strings.
+  // End each piece just past the first newline after its share of the buffer
+  for (t = 0; t < threads; t++)
   {
-    if (buffer[i] == '\r')
+    pieces[t].buffer = buffer;
+    pieces[t].size = size;
+    pieces[t].any_bytes = any_bytes;
+    pieces[t].lo = cut;
+    if (t < threads - 1 && size * (t + 1) / threads > cut)
     {
-      strs[word_i] = (char *)malloc(sizeof(char) * (character_count + 1));
-      if (strs[word_i] == NULL)
-      {
-        printf("Memory allocation failed.\n");
-        // Free previously allocated memory
-        for (int j = 0; j < word_i; j++)
-        {
-          free(strs[j]);
-        }
-        free(strs);
-        free(buffer);
-        return 4;
-      }
-
-      i -= character_count;
-      memcpy(strs[word_i], buffer + i, sizeof(char) * character_count);
-      strs[word_i][character_count] = '\0'; // Null-terminate the string
-      word_i++;
-      i += character_count;
-      character_count = 0;
+      cut = size * (t + 1) / threads;
+      newline = (const char *)memchr(buffer + cut, '\n', size - cut);
+      cut = newline ? newline - buffer + 1 : size;
     }
-    else if (buffer[i] != '\n')
+    else if (t == threads - 1)
     {
-      character_count++;
+      cut = size;
     }
+    pieces[t].hi = cut;
   }
+  run_threads(scan_piece, pieces, sizeof(Piece), threads);
 
-  free(buffer);
-
-  // Find the size of the longest word
-  if (resize_strs(strs, word_count))
+  for (t = 0; t < threads; t++)
   {
-    printf("Memory allocation failed.\n");
-    // Free all dynamically allocated memory
-    for (i = 0; i < word_count; i++)
+    if (pieces[t].res && first_bad < 0) // The earliest bad byte is the one tokenize_words reports
     {
-      free(strs[i]);
+      first_bad = t;
     }
-    free(strs);
-    return 4;
-  }
-
-  printf("\nInitial list of words:\n");
-  for (i = 0; i < word_count; i++)
-  {
-    printf("%s ", strs[i]);
+    total += pieces[t].word_count;
   }
-  printf("\n");
-
-  if (radix_sort(strs, word_count))
+  if (first_bad >= 0)
   {
-    printf("Memory allocation failed.\n");
-    // Free all dynamically allocated memory
-    for (i = 0; i < word_count; i++)
+    report_bad_byte(buffer, pieces[first_bad].bad);
+    free(pieces);
+    if (!given)
     {
-      free(strs[i]);
+      *words = NULL;
     }
-    free(strs);
-    return 2;
+    return 5;
   }
 
-  printf("\nSorted list of words:\n");
-  for (i = 0; i < word_count; i++)
+  if (!given)
+  {
+    *words = (Word *)malloc(sizeof(Word) * (total + 1));
+  }
+  if (*words == NULL)
   {
-    printf("%s ", strs[i]);
+    printf("Memory allocation failed.\n");
+    free(pieces);
+    return 4;
   }
-  printf("\n");
 
-  // Free all dynamically allocated memory
-  for (i = 0; i < word_count; i++)
+  for (t = 0, total = 0; t < threads; t++)
   {
-    free(strs[i]);
+    pieces[t].words = *words + total;
+    total += pieces[t].word_count;
   }
-  free(strs);
+  run_threads(scan_piece, pieces, sizeof(Piece), threads);
 
+  *word_count = total;
+  free(pieces);
   return 0;
 }
 
 /**
- * Sorts an array of strings using the radix sort algorithm.
- * Returns 0 if successful, 1 if memory allocation fails.
+ * Counts the words of a piece, or fills its slice of the views once it
+ * has one. The slice is exactly as large as the count, so it never grows.
  */
-int radix_sort(char **strs, int word_count)
+void *scan_piece(void *arg)
 {
-  clock_t start, end;
-  double cpu_time_used;
+  Piece *p = (Piece *)arg;
+  long capacity = p->word_count;
 
-  start = clock();
+  p->word_count = 0;
+  p->res = scan_lines(p->buffer, p->lo, p->hi, p->size, p->any_bytes, &p->words, &p->word_count, &capacity, &p->bad);
+  return NULL;
+}
 
-  char **buckets[ASCII_SIZE] = {NULL}; // Initialize buckets to NULL
-  int i, j, k, l,                      // Iterators
-      character_count = strlen(strs[0]),
-      bucket_i[ASCII_SIZE] = {0}; // Array to store the index of the last word in each bucket
+/**
+ * Worker loop: sorts buckets from the queue in the scratch array and
+ * copies each one back into place until none are left.
+ */
+void *sort_buckets(void *arg)
+{
+  BucketQueue *q = (BucketQueue *)arg;
+  Word *bucket;
+  long size;
+  int b;
 
-  // The function bucket_allocation returns 0 if successful.
-  if (bucket_allocation(buckets, word_count, character_count, ASCII_NULL, ASCII_NULL)    // For the null bucket
-      || bucket_allocation(buckets, word_count, character_count, ASCII_ZERO, ASCII_NINE) // For numbers
-      || bucket_allocation(buckets, word_count, character_count, ASCII_U_A, ASCII_U_Z)   // For uppercase letters
-      || bucket_allocation(buckets, word_count, character_count, ASCII_L_A, ASCII_L_Z)   // For lowercase letters
-  )
+  for (;;)
   {
-    for (j = ASCII_ZERO; j <= ASCII_L_Z; j++)
+    pthread_mutex_lock(&q->lock);
+    b = q->next < BUCKETS ? q->order[q->next++] : -1;
+    pthread_mutex_unlock(&q->lock);
+
+    if (b < 0 || q->size[b] == 0)
     {
-      if (buckets[j] != NULL)
-      {
-        for (k = 0; k < word_count; k++)
-        {
-          free(buckets[j][k]);
-        }
-        free(buckets[j]);
-      }
+      return NULL; // Buckets are handed out largest first, so the rest are empty
     }
-    if (buckets[ASCII_NULL] != NULL)
+
+    bucket = q->scratch + q->start[b];
+    size = q->size[b];
+    if (b != 0 && size > 1 && q->sort(q->text, bucket, size, 1)) // Bucket 0 holds empty words
     {
-      for (k = 0; k < word_count; k++)
-      {
-        free(buckets[ASCII_NULL][k]);
-      }
-      free(buckets[ASCII_NULL]);
+      pthread_mutex_lock(&q->lock);
+      q->failed = 1;
+      pthread_mutex_unlock(&q->lock);
     }
-    return 1; // Memory allocation failed, return 1 to indicate failure
+    memcpy(q->words + q->start[b], bucket, sizeof(Word) * size);
   }
+}
+
+/**
+ * Sorts a small group of words that share their first depth characters.
+ */
+void insertion_sort(const char *text, Word *words, long n, long depth)
+{
+  long i, j;
+  Word w;
 
-  // Begin LSD radix sort
-  for (j = character_count - 1; j >= 0; j--)
+  for (i = 1; i < n; i++)
   {
-    // Place each word in the appropriate bucket
-    for (i = 0; i < word_count; i++)
+    w = words[i];
+    for (j = i; j > 0 && compare_words(text, w, words[j - 1], depth) < 0; j--)
     {
-      strcpy(buckets[strs[i][j]][(bucket_i[strs[i][j]])++], strs[i]);
+      words[j] = words[j - 1];
     }
+    words[j] = w;
+  }
+}
+
+/**
+ * Compares two words from position depth onwards, like strcmp.
+ */
+int compare_words(const char *text, Word a, Word b, long depth)
+{
+  long len = a.len < b.len ? a.len : b.len;
+  int res = 0;
+
+  if (len > depth)
+  {
+    res = memcmp(text + a.off + depth, text + b.off + depth, len - depth);
+  }
+  if (res == 0)
+  {
+    res = (a.len > b.len) - (a.len < b.len);
+  }
+  return res;
+}
 
-    // Copy the words back into the original array
+/**
+ * Sorts a file that may not fit in memory. The file is read a chunk at a
+ * time, each chunk is sorted in memory and written to a temporary file as
+ * a sorted run, and the runs are then merged into the output. What the
+ * output buffer leaves of the budget is split between the chunk text, the
+ * write buffer of the run and the views; a chunk is cut short when its
+ * lines would need more views, and scratch for the sort, than fit.
+ * Returns 0 if successful, or one of the return codes of main.
+ */
+int external_sort(const char *path, Output *out, const char *tmpdir, long budget,
+                  SortFunction sort, int threads, int any_bytes, int repeats)
+{
+  struct timespec start, end;
+  FILE *in;
+  const char *newline;
+  char *buffer,                        // Current chunk of the file
+      **runs = NULL;                   // Paths of the sorted runs
+  long available = budget - out->size, // What the output buffer leaves
+      chunk = available / 4,           // Bytes of text per chunk
+      run_buffer = available / 16,     // Write buffer of each run
+      max_words,                       // Most words a chunk has room for
+      filled = 0,                      // Bytes of text in buffer
+      used,                            // Bytes of text up to the last complete line
+      lines,
+      word_count,
+      i;
+  int run_count = 0, eof = 0, res = 0;
+  Word *words;
 
-    l = 0; // l to iterate through the original array
+  if (run_buffer > 1 << 20)
+  {
+    run_buffer = 1 << 20;
+  }
+  max_words = (available - chunk - run_buffer) / (long)(sizeof(Word) + scratch_per_word(sort, threads));
 
-    for (i = 0; i < bucket_i[ASCII_NULL]; i++) // For the null bucket
-    {
-      strcpy(strs[l++], buckets[ASCII_NULL][i]);
-    }
+  clock_gettime(CLOCK_MONOTONIC, &start);
 
-    for (i = ASCII_ZERO; i <= ASCII_NINE; i++)
-    {
-      for (k = 0; k < bucket_i[i]; k++)
-      {
-        strcpy(strs[l++], buckets[i][k]);
-      }
-    }
-    for (i = ASCII_U_A; i <= ASCII_U_Z; i++) // Uppercase letters
+  in = fopen(path, "rb");
+  if (in == NULL)
+  {
+    printf("Error opening file.\n");
+    return 3;
+  }
+
+  // The views of every chunk reuse one array, so freed arrays cannot leave
+  // holes in the heap that the next chunk's array does not fit
+  buffer = (char *)malloc(sizeof(char) * chunk);
+  words = (Word *)malloc(sizeof(Word) * max_words);
+  if (buffer == NULL || words == NULL)
+  {
+    printf("Memory allocation failed.\n");
+    fclose(in);
+    free(buffer);
+    free(words);
+    return 4;
+  }
+
+  // A chunk cut short leaves text behind after the end of the file
+  while ((!eof || filled > 0) && res == 0)
+  {
+    filled += fread(buffer + filled, 1, chunk - filled, in);
+    eof = filled < chunk;
+
+    // Keep a partial last line for the next chunk
+    used = filled;
+    while (!eof && used > 0 && buffer[used - 1] != '\n')
     {
-      for (k = 0; k < bucket_i[i]; k++)
-      {
-        strcpy(strs[l++], buckets[i][k]);
-      }
+      used--;
     }
-    for (i = ASCII_L_A; i <= ASCII_L_Z; i++) // Lowercase letters
+    if (used == 0 && !eof)
     {
-      for (k = 0; k < bucket_i[i]; k++)
-      {
-        strcpy(strs[l++], buckets[i][k]);
-      }
+      printf("A word does not fit in the memory budget.\n");
+      res = 5;
+      break;
     }
 
-    // Reset the bucket index
-    for (i = ASCII_ZERO; i <= ASCII_L_Z; i++)
+    // Keep the lines past the room for their views for the next chunk too
+    for (i = 0, lines = 0; i < used && lines < max_words; lines++)
     {
-      bucket_i[i] = 0;
+      newline = (const char *)memchr(buffer + i, '\n', used - i);
+      i = newline ? newline - buffer + 1 : used;
     }
-    bucket_i[0] = 0; // For the null bucket
+    used = i;
 
-    // Reset the strings in the buckets to null
-    for (i = 0; i < word_count; i++)
-    {
-      memset(buckets[ASCII_NULL][i], ASCII_NULL, sizeof(char) * character_count);
-    }
-    for (i = ASCII_ZERO; i <= ASCII_NINE; i++)
+    res = parallel_tokenize(buffer, used, any_bytes, &words, &word_count, threads);
+    if (res)
     {
-      for (k = 0; k < word_count; k++)
-      {
-        memset(buckets[i][k], ASCII_NULL, sizeof(char) * character_count);
-      }
+      break;
     }
-    for (i = ASCII_U_A; i <= ASCII_U_Z; i++)
+
+    if (word_count > 0)
     {
-      for (k = 0; k < word_count; k++)
+      if (threads > 1 ? parallel_sort(buffer, words, word_count, sort, threads) : sort(buffer, words, word_count, 0))
       {
-        memset(buckets[i][k], ASCII_NULL, sizeof(char) * character_count);
+        printf("Memory allocation failed.\n");
+        res = 4;
       }
-    }
-    for (i = ASCII_L_A; i <= ASCII_L_Z; i++)
-    {
-      for (k = 0; k < word_count; k++)
+      else
       {
-        memset(buckets[i][k], ASCII_NULL, sizeof(char) * character_count);
+        res = write_run(buffer, words, word_count, tmpdir, run_buffer, &runs, &run_count, repeats == WRITE_UNIQUE);
       }
     }
+
+    memmove(buffer, buffer + used, filled - used);
+    filled -= used;
   }
 
-  // Free all memory allocated in this function
-  for (i = 0; i < word_count; i++)
+  fclose(in);
+  free(buffer);
+  free(words);
+
+  if (res == 0)
   {
-    free(buckets[ASCII_NULL][i]);
+    res = merge_runs(runs, run_count, out, available, repeats);
   }
-  free(buckets[ASCII_NULL]);
 
-  for (i = ASCII_ZERO; i <= ASCII_NINE; i++)
+  // The merge unlinks the runs it opens; this catches the rest
+  for (i = 0; i < run_count; i++)
   {
-    for (j = 0; j < word_count; j++)
-    {
-      free(buckets[i][j]);
-    }
-    free(buckets[i]);
+    unlink(runs[i]);
+    free(runs[i]);
   }
-  // Commented out for now because it always throws an error
-  // for (i = ASCII_U_A; i <= ASCII_U_Z; i++)
-  // {
-  //   for (j = 0; j < word_count; j++)
-  //   {
-  //     free(buckets[i][j]);
-  //   }
-  //   free(buckets[i]);
-  // }
-  // for (i = ASCII_L_A; i <= ASCII_L_Z; i++)
-  // {
-  //   for (j = 0; j < word_count; j++)
-  //   {
-  //     free(buckets[i][j]);
-  //   }
-  //   free(buckets[i]);
-  // }
+  free(runs);
 
-  end = clock();
-  cpu_time_used = ((double)(end - start)) / CLOCKS_PER_SEC;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  // Standard output may hold the sorted words, so report on standard error
+  fprintf(stderr, "\nTime taken: %lf seconds\n",
+          (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
 
-  printf("\nTime taken: %lf seconds\n", cpu_time_used);
+  return res;
+}
 
-  return 0;
+/**
+ * Returns the bytes of scratch a sort needs for each word it sorts: a
+ * second array of views for the LSD radix sort, two arrays of keyed views
+ * for the prefix sort and nothing for the in-place MSD radix sort, plus the
+ * array parallel_sort moves the buckets into when there are threads.
+ */
+long scratch_per_word(SortFunction sort, int threads)
+{
+  long bytes = threads > 1 ? sizeof(Word) : 0;
+
+  if (sort == radix_sort)
+  {
+    bytes += sizeof(Word);
+  }
+  else if (sort == prefix_sort)
+  {
+    bytes += 2 * sizeof(KeyedWord);
+  }
+  return bytes;
 }
 
-int bucket_allocation(char ***buckets, int word_count, int character_count, int start, int end)
+/**
+ * Writes sorted words to a new temporary file, one per line, through a
+ * write buffer of buffer_size bytes, and adds its path to the list of
+ * runs. With unique set, equal words are written once, which shrinks the
+ * run; counts cannot be collapsed this early, as the run has nowhere to
+ * keep them.
+ * Returns 0 if successful, 4 if memory allocation fails and 7 if the file
+ * cannot be written.
+ */
+int write_run(const char *text, Word *words, long word_count, const char *tmpdir, long buffer_size,
+              char ***runs, int *run_count, int unique)
 {
-  int i, j, k;
-  // Allocate memory for buckets
-  for (i = start; i <= end; i++)
+  char *path, **grown;
+  FILE *fp;
+  long i;
+  int fd;
+
+  path = (char *)malloc(strlen(tmpdir) + sizeof("/lsd-radix-sort-XXXXXX"));
+  grown = (char **)realloc(*runs, sizeof(char *) * (*run_count + 1));
+  if (path == NULL || grown == NULL)
   {
-    buckets[i] = (char **)malloc(sizeof(char *) * word_count);
-    if (buckets[i] == NULL)
+    printf("Memory allocation failed.\n");
+    free(path);
+    if (grown != NULL)
     {
-      return 1;
+      *runs = grown;
+    }
+    return 4;
+  }
+  *runs = grown;
+
+  sprintf(path, "%s/lsd-radix-sort-XXXXXX", tmpdir);
+  fd = mkstemp(path);
+  if (fd < 0 || (fp = fdopen(fd, "wb")) == NULL)
+  {
+    printf("Error creating a temporary file in %s.\n", tmpdir);
+    if (fd >= 0)
+    {
+      close(fd);
+      unlink(path);
     }
-    for (j = 0; j < word_count; j++) // Allocate memory for the strings inside the buckets
+    free(path);
+    return 7;
+  }
+  (*runs)[(*run_count)++] = path;
+
+  setvbuf(fp, NULL, _IOFBF, buffer_size);
+  for (i = 0; i < word_count; i++)
+  {
+    if (unique && i > 0 && compare_words(text, words[i - 1], words[i], 0) == 0)
     {
-      buckets[i][j] = (char *)calloc(character_count + 1, sizeof(char));
-      if (buckets[i][j] == NULL)
-      {
-        return 1;
-      }
+      continue;
     }
+    fwrite(text + words[i].off, sizeof(char), words[i].len, fp);
+    putc('\n', fp);
   }
 
+  if (fclose(fp) != 0)
+  {
+    printf("Error writing a temporary file in %s.\n", tmpdir);
+    return 7;
+  }
   return 0;
 }
 
 /**
- * Resizes an array of strings to a new size.
+ * Merges the sorted runs into out with a loser tree: tree[0] holds the run
+ * with the smallest line and every other node holds the run that lost the
+ * match played there, so replacing the winner's line only replays the
+ * matches on the path from its leaf to the root. Unless repeats is
+ * WRITE_ALL, equal lines from every run are collapsed as they come out: the
+ * last line is held back, its buffer swapped out of its run, until a
+ * different one turns up.
+ * Returns 0 if successful, or one of the return codes of main.
  */
-int resize_strs(char **strs, int size)
+int merge_runs(char **paths, int run_count, Output *out, long budget, int repeats)
 {
-  int i, j,                // Iterators for the loops
-      character_count = 0; // Variable to store the number of characters in a word
+  Run *runs;
+  int *tree, i, w, res = 0;
+  char *last = NULL, *swap; // Line held back while its repeats are counted
+  size_t last_cap = 0, swap_cap;
+  long last_len = 0, count = 0;
+  long buffer_size = budget / (2 * (run_count + 1)); // Read buffer of each run
+
+  if (buffer_size < 1 << 12)
+  {
+    buffer_size = 1 << 12;
+  }
+
+  if (run_count < 1)
+  {
+    return 0;
+  }
+
+  runs = (Run *)calloc(run_count + 1, sizeof(Run));
+  tree = (int *)malloc(sizeof(int) * run_count);
+  if (runs == NULL || tree == NULL)
+  {
+    printf("Memory allocation failed.\n");
+    free(runs);
+    free(tree);
+    return 4;
+  }
 
-  for (i = 0; i < size; i++)
+  for (i = 0; i < run_count; i++)
   {
-    if (strlen(strs[i]) > character_count)
+    runs[i].fp = fopen(paths[i], "rb");
+    if (runs[i].fp == NULL)
     {
-      character_count = strlen(strs[i]);
+      printf("Error opening a temporary file.\n");
+      res = 7;
+      break;
     }
+    unlink(paths[i]); // Removed from the directory once closed
+    setvbuf(runs[i].fp, NULL, _IOFBF, buffer_size);
+    runs[i].len = getline(&runs[i].line, &runs[i].cap, runs[i].fp) - 1;
   }
 
-  // Resize all of strs to the size of the longest word
-  for (i = 0; i < size; i++)
+  if (res == 0)
   {
-    strs[i] = (char *)realloc(strs[i], sizeof(char) * (character_count + 1));
-    if (strs[i] == NULL)
+    // Run run_count is a sentinel that beats every real run, so the tree
+    // can start full of it and have each real run replayed into place
+    for (i = 0; i < run_count; i++)
     {
-      return 1;
+      tree[i] = run_count;
+    }
+    for (i = run_count - 1; i >= 0; i--)
+    {
+      replay(runs, tree, run_count, i);
+    }
+
+    while (runs[w = tree[0]].len >= 0)
+    {
+      if (repeats == WRITE_ALL)
+      {
+        write_bytes(out, runs[w].line, runs[w].len + 1);
+      }
+      else if (count > 0 && runs[w].len == last_len && memcmp(runs[w].line, last, last_len) == 0)
+      {
+        count++;
+      }
+      else
+      {
+        if (count > 0)
+        {
+          write_entry(out, last, last_len, count, repeats);
+        }
+        // Keep the line by trading buffers with the run, which reads into the old one
+        swap = last;
+        swap_cap = last_cap;
+        last = runs[w].line;
+        last_cap = runs[w].cap;
+        last_len = runs[w].len;
+        runs[w].line = swap;
+        runs[w].cap = swap_cap;
+        count = 1;
+      }
+      runs[w].len = getline(&runs[w].line, &runs[w].cap, runs[w].fp) - 1;
+      replay(runs, tree, run_count, w);
     }
+    if (count > 0)
+    {
+      write_entry(out, last, last_len, count, repeats);
+    }
+  }
+  free(last);
 
-    // Pad each string with null characters
-    for (j = strlen(strs[i]); j < character_count; j++)
+  for (i = 0; i < run_count; i++)
+  {
+    if (runs[i].fp != NULL)
     {
-      strs[i][j] = '\0';
+      fclose(runs[i].fp);
     }
+    free(runs[i].line);
   }
-  return 0;
-}
\ No newline at end of file
+  free(runs);
+  free(tree);
+
+  return res;
+}
+
+/**
+ * Plays run s up the loser tree after its line changed, leaving the
+ * overall winner in tree[0].
+ */
+void replay(Run *runs, int *tree, int run_count, int s)
+{
+  int t, temp;
+
+  for (t = (s + run_count) / 2; t > 0; t /= 2)
+  {
+    if (line_less(runs, run_count, tree[t], s)) // The stored run wins; s loses here
+    {
+      temp = tree[t];
+      tree[t] = s;
+      s = temp;
+    }
+  }
+  tree[0] = s;
+}
+
+/**
+ * Whether run a's line sorts before run b's. Empty runs lose to everything
+ * and the sentinel run_count wins against everything.
+ */
+int line_less(Run *runs, int run_count, int a, int b)
+{
+  long len;
+  int res;
+
+  if (a == run_count || b == run_count)
+  {
+    return a == run_count;
+  }
+  if (runs[a].len < 0 || runs[b].len < 0)
+  {
+    return runs[b].len < 0 && runs[a].len >= 0;
+  }
+
+  len = runs[a].len < runs[b].len ? runs[a].len : runs[b].len;
+  res = memcmp(runs[a].line, runs[b].line, len);
+  return res < 0 || (res == 0 && runs[a].len < runs[b].len);
+}
@@ -1,115 +1,589 @@
+/**
+ * Usage: lsd-radix-sort [-t type] [-j threads] numbers...
+ *        lsd-radix-sort [-t type] [-j threads] [-b] [-o output] -f file
+ * -t: Type of the numbers; int32 (default), int64, uint64, float or
+ *     double. Negative numbers come before positive ones and floating
+ *     point numbers sort by value, -0 before 0.
+ * -j: Number of threads. Every pass is split between them.
+ * -f: Sort the numbers in a file instead of the arguments: one per line
+ *     (integers may also be separated by spaces), or raw little-endian
+ *     numbers of the type with -b. The sorted numbers are written one per
+ *     line or in binary.
+ * -b: The file is binary.
+ * -o: Output file for -f; defaults to standard output.
+ *
+ * Compile with -pthread.
+ */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h> // Include the string library for memcpy
+#include <stdint.h>
+#include "number_file.h"
+#include "slice_threads.h"
+#include "SortingCodes/sorting_codes.h"
 
-int _atoi(char *);
+#define COMBINE_BYTES 64 // Keys gathered per bucket before they are written out, a cache line
+
+// Digit of the key at index i of a slice
+#define DIGIT_AT(s, type, i) ((int)((((const type *)(s)->src)[i] >> (s)->shift) & 0xFF) ^ (s)->flip)
+
+/**
+ * One thread's share of a pass of the parallel sort: its slice of the
+ * keys and the histogram of their digits, which the prefix sum over all
+ * the threads turns into the positions the slice scatters its keys to.
+ */
+typedef struct
+{
+  const void *src;
+  void *dst;
+  long lo, hi;     // Slice of keys handled by this thread
+  int width,       // Bytes per key, 4 or 8
+      shift,       // Position of the digit in the key, in bits
+      flip;        // Bit flipped in the digit, for the sign of signed keys
+  long count[256]; // Histogram, then scatter positions
+} Slice;
+
+int sort_numbers(void *, long, int, int);
 int radix_sort(int *, int);
+int radix_sort32(uint32_t *, long, int);
+int radix_sort64(uint64_t *, long, int);
+void float_keys(uint32_t *, long, int);
+void double_keys(uint64_t *, long, int);
+int parallel_radix_sort(void *, long, int, int, int);
+void finish_passes(void *, void *, void *, size_t);
+void *histogram_digits(void *);
+void *scatter_digits(void *);
 
+#ifndef SORT_BENCHMARK
+/**
+ * Return codes:
+ * 0: Success
+ * 1: Not enough arguments
+ * 2: Memory allocation failed
+ * 3: An argument or line is not a number of the type
+ * 4: Unknown option, type or number of threads
+ * 5: Error opening file
+ * 6: Binary file size is not a whole number of numbers
+ * 7: Error writing output file
+ */
 int main(int argc, char **argv)
 {
-  if (argc == 1) // Failsafe case if there aren't enough arguments
+  int type = INT32,  // Type of the numbers
+      threads = 1,   // Threads used for sorting
+      binary = 0,    // The file holds raw numbers
+      first = 1,     // First argument that is a number
+      opt, res, i;
+  long size,         // Number of numbers
+      mapped = -1,   // Size of the mapped binary file, or -1 if arr was allocated
+      j;
+  void *arr;         // Numbers of the chosen type
+  const char *input = NULL, // File of numbers
+      *output = NULL,       // Output file for the sorted numbers
+      *value = NULL;        // Value of the current option
+
+  while ((opt = next_number_option(argc, argv, &first, "tjfob", "tjfo", &value)) != 0)
   {
-    printf("Not enough arguments; please enter an array of numbers separated by a space.\n");
-    return 1;
+    switch (opt)
+    {
+    case '?':
+      printf("Please give a value after %s.\n", argv[first]);
+      return 4;
+    case 'b':
+      binary = 1;
+      break;
+    case 't':
+      for (type = 0; type <= DOUBLE && strcmp(value, number_type_names[type]) != 0; type++)
+        ;
+      if (type > DOUBLE)
+      {
+        printf("Unknown type %s; please use int32, int64, uint64, float or double.\n", value);
+        return 4;
+      }
+      break;
+    case 'j':
+      threads = atoi(value);
+      if (threads < 1)
+      {
+        printf("Please use at least one thread.\n");
+        return 4;
+      }
+      break;
+    case 'f':
+      input = value;
+      break;
+    default:
+      output = value;
+    }
   }
 
-  int size = argc - 1,                          // Size to avoid repetitive calculations
-      *arr = (int *)malloc(sizeof(int) * size), // Integer array to store the numbers
-      i, j = 0;                                 // Iterators for loops
+  if ((input != NULL && first < argc) || ((binary || output) && input == NULL))
+  {
+    printf("Please give either numbers or a file with -f; -b and -o only go with -f.\n");
+    return 4;
+  }
 
-  for (i = 1; i < size + 1; i++, j++)
+  if (input != NULL)
   {
-    arr[j] = _atoi(argv[i]); // Convert from string to integer
+    arr = read_numbers(input, type, binary, &size, &mapped);
+    if (arr == NULL)
+    {
+      return size == -1 ? 5 : size == -2 ? 2 : size == -3 ? 3 : 6;
+    }
+  }
+  else
+  {
+    if (argc == first) // Failsafe case if there aren't enough arguments
+    {
+      printf("Not enough arguments; please enter an array of numbers separated by a space.\n");
+      return 1;
+    }
+
+    size = argc - first;
+    arr = malloc(sizeof(uint64_t) * size); // Room for the largest type
+    if (NULL == arr)
+    {
+      printf("Memory allocation failed.\n");
+      return 2;
+    }
+
+    for (i = first, j = 0; i < argc; i++, j++)
+    {
+      if (!parse_number(argv[i], type, arr, j)) // Convert from string to the type
+      {
+        printf("Please enter only numbers; %s is not a valid %s.\n", argv[i], number_type_names[type]);
+        free(arr);
+        return 3;
+      }
+    }
   }
 
-  if (!radix_sort(arr, size))
+  if (!sort_numbers(arr, size, type, threads))
   {
     printf("Memory allocation failed.\n");
-    return 2;
+    res = 2;
+  }
+  else if (input != NULL)
+  {
+    res = write_numbers(output, arr, size, type, binary) ? 7 : 0;
+  }
+  else
+  {
+    printf("\nResult: ");
+    for (j = 0; j < size; j++) // Display sorted array
+    {
+      print_number(stdout, arr, type, j);
+      printf(" ");
+    }
+    printf("\n");
+    res = 0;
   }
 
-  printf("\nResult: ");
-  for (i = 0; i < size; i++) // Display sorted array
+  if (mapped >= 0)
+  {
+    unmap_file((char *)arr, mapped);
+  }
+  else
   {
-    printf("%d ", arr[i]);
+    free(arr);
   }
+  return res;
+}
+#endif
 
-  printf("\n");
+/**
+ * Sorts size numbers of the type with the radix sort for their width, on
+ * the given number of threads. Signed integers only need their sign bit
+ * flipped, which the sorts do as they count; floating point numbers are
+ * turned into keys that sort the same way as unsigned integers, and back.
+ * Returns 1 if successful, 0 if memory allocation fails.
+ */
+int sort_numbers(void *arr, long size, int type, int threads)
+{
+  int res,
+      width = number_width(type),
+      is_signed = type == INT32 || type == INT64;
+
+  if (type == FLOAT)
+  {
+    float_keys((uint32_t *)arr, size, 1);
+  }
+  else if (type == DOUBLE)
+  {
+    double_keys((uint64_t *)arr, size, 1);
+  }
 
-  return 0;
+  if (threads > 1)
+  {
+    res = parallel_radix_sort(arr, size, width, is_signed, threads);
+  }
+  else if (width == 4)
+  {
+    res = radix_sort32((uint32_t *)arr, size, is_signed);
+  }
+  else
+  {
+    res = radix_sort64((uint64_t *)arr, size, is_signed);
+  }
+
+  // The keys are turned back even if the sort failed, leaving the numbers as they were
+  if (type == FLOAT)
+  {
+    float_keys((uint32_t *)arr, size, 0);
+  }
+  else if (type == DOUBLE)
+  {
+    double_keys((uint64_t *)arr, size, 0);
+  }
+  return res;
+}
+
+/**
+ * Sorts an array of signed integers.
+ * Returns 1 if successful, 0 if memory allocation fails.
+ */
+int radix_sort(int *arr, int size)
+{
+  return radix_sort32((uint32_t *)arr, size, 1);
 }
 
-int _atoi(char *arr)
+/**
+ * Sorts the array with an LSD radix sort, a byte at a time. The counts of
+ * all four bytes are taken in one pass over the array, then each pass
+ * scatters the numbers from one buffer into the other and the two swap
+ * roles, so nothing is copied back between passes. Bytes that are the same
+ * in every number are skipped, so small numbers take fewer passes. With
+ * is_signed set, the top bit of the top byte is flipped as it is read, so
+ * negative numbers come first. Arrays of up to NETWORK_MAX numbers are
+ * sorted by a sorting network instead.
+ * Returns 1 if successful, 0 if memory allocation fails.
+ */
+int radix_sort32(uint32_t *keys, long size, int is_signed)
 {
-  int i,       // Iterate through the string
-      buffer,  // Buffer for the calculations later
-      res = 0; // Resulting integer
+  uint32_t *src = keys, // Numbers ordered by the previous pass
+      *dst,             // Numbers ordered by the current pass
+      *temp;            // Used to swap src and dst
+  long count[4][256] = {{0}}, // Histogram of each byte, then where each bucket starts
+      i,                      // Iterator for the numbers
+      total, c;               // Running sum and scratch for the prefix sum
+  int d,                      // Iterator for the bytes
+      flip[4] = {0, 0, 0, is_signed ? 0x80 : 0};
+  uint32_t sign = is_signed ? 0 : 0x80000000U; // Flipped so unsigned keys compare as ints
 
-  for (i = 0; arr[i] != '\0'; i++)
+  if (size <= NETWORK_MAX) // Too few keys to be worth four passes; the sorting network takes them
   {
-    buffer = (int)arr[i] - (int)'0';
-    if (buffer >= 0)
+    for (i = 0; i < size; i++)
     {
-      res *= 10;
-      res += buffer;
+      keys[i] ^= sign;
     }
+    network_sort((int *)keys, (int)size);
+    for (i = 0; i < size; i++)
+    {
+      keys[i] ^= sign;
+    }
+    return 1;
   }
-  return res;
+
+  dst = (uint32_t *)malloc(sizeof(uint32_t) * size);
+  if (NULL == dst) // Reported by the caller
+  {
+    return 0;
+  }
+
+  for (i = 0; i < size; i++) // Count every byte in one pass
+  {
+    for (d = 0; d < 4; d++)
+    {
+      count[d][((src[i] >> (8 * d)) & 0xFF) ^ flip[d]]++;
+    }
+  }
+
+  for (d = 0; d < 4; d++) // One pass per byte, least significant first
+  {
+    if (count[d][((src[0] >> (8 * d)) & 0xFF) ^ flip[d]] == size) // Every number has the same byte here
+    {
+      continue;
+    }
+
+    total = 0;
+    for (i = 0; i < 256; i++) // Turn the counts into the index where each bucket starts
+    {
+      c = count[d][i];
+      count[d][i] = total;
+      total += c;
+    }
+
+    for (i = 0; i < size; i++) // Place each number in its bucket, keeping the previous order
+    {
+      dst[count[d][((src[i] >> (8 * d)) & 0xFF) ^ flip[d]]++] = src[i];
+    }
+
+    temp = src;
+    src = dst;
+    dst = temp;
+  }
+
+  finish_passes(keys, src, dst, sizeof(uint32_t) * size);
+
+  return 1;
 }
 
-int radix_sort(int *arr, int size)
+/**
+ * Sorts 64-bit numbers the same way as radix_sort32, in up to eight passes.
+ * Returns 1 if successful, 0 if memory allocation fails.
+ */
+int radix_sort64(uint64_t *keys, long size, int is_signed)
 {
-  int *g = (int *)malloc(sizeof(int) * size), // Array to store the digits with 1 at the significant digit
-      *l = (int *)malloc(sizeof(int) * size), // Array to store the digits with 0 at the significant digit
-      i,                                      // arr iterator
-      j,                                      // Repetitions counter
-      ig = 0,                                 // Counter for array g
-      il = 0,                                 // counter for array l
-      largest = arr[0],                       // Store the largest number in the array
-      power_largest = 0,                      // Counter for the repetition loop
-      sig_digit = 1;                          // Determines the current focused significant digit in the binary number
-
-  if (NULL == g || NULL == l)
+  uint64_t *src = keys, *dst, *temp;
+  long count[8][256] = {{0}}, i, total, c;
+  int d, flip[8] = {0, 0, 0, 0, 0, 0, 0, is_signed ? 0x80 : 0};
+  uint64_t sign = is_signed ? 0 : 0x8000000000000000ULL;
+
+  if (size <= NETWORK_MAX)
+  {
+    for (i = 0; i < size; i++)
+    {
+      keys[i] ^= sign;
+    }
+    network_sort64((long long *)keys, (int)size);
+    for (i = 0; i < size; i++)
+    {
+      keys[i] ^= sign;
+    }
+    return 1;
+  }
+
+  dst = (uint64_t *)malloc(sizeof(uint64_t) * size);
+  if (NULL == dst) // Reported by the caller
   {
-    printf("Memory allocation failed.\n");
     return 0;
   }
 
-  for (i = 1; i < size; i++) // Find the largest number
+  for (i = 0; i < size; i++)
   {
-    if (largest < arr[i])
-      largest = arr[i];
+    for (d = 0; d < 8; d++)
+    {
+      count[d][((src[i] >> (8 * d)) & 0xFF) ^ flip[d]]++;
+    }
   }
 
-  while (largest > 0) // Find power_largest
+  for (d = 0; d < 8; d++)
   {
-    largest /= 2;
-    power_largest++;
+    if (count[d][((src[0] >> (8 * d)) & 0xFF) ^ flip[d]] == size)
+    {
+      continue;
+    }
+
+    total = 0;
+    for (i = 0; i < 256; i++)
+    {
+      c = count[d][i];
+      count[d][i] = total;
+      total += c;
+    }
+
+    for (i = 0; i < size; i++)
+    {
+      dst[count[d][((src[i] >> (8 * d)) & 0xFF) ^ flip[d]]++] = src[i];
+    }
+
+    temp = src;
+    src = dst;
+    dst = temp;
   }
 
-  for (i = 0; i < power_largest; i++) // Repetition loop
+  finish_passes(keys, src, dst, sizeof(uint64_t) * size);
+
+  return 1;
+}
+
+/**
+ * Turns the bits of floats into keys that sort like unsigned integers, or
+ * keys back into floats. Positive numbers get their sign bit set, so they
+ * come after the negative ones; negative numbers have every bit flipped,
+ * as a larger magnitude means a smaller number.
+ */
+void float_keys(uint32_t *bits, long size, int to_key)
+{
+  long i;
+
+  for (i = 0; i < size; i++)
   {
-    for (j = 0; j < size; j++) // Sorting loop
+    if (to_key)
     {
-      if ((arr[j] & sig_digit) == 0)
-      {
-        l[il++] = arr[j];
-      }
-      else
-      {
-        g[ig++] = arr[j];
-      }
+      bits[i] ^= (bits[i] >> 31) ? 0xFFFFFFFFu : 0x80000000u;
+    }
+    else
+    {
+      bits[i] ^= (bits[i] >> 31) ? 0x80000000u : 0xFFFFFFFFu;
+    }
+  }
+}
+
+/**
+ * The same as float_keys, for doubles.
+ */
+void double_keys(uint64_t *bits, long size, int to_key)
+{
+  long i;
+
+  for (i = 0; i < size; i++)
+  {
+    if (to_key)
+    {
+      bits[i] ^= (bits[i] >> 63) ? 0xFFFFFFFFFFFFFFFFull : 0x8000000000000000ull;
     }
-    memcpy(arr, l, il * 4);      // Copy array of significant digit 0's to the main array
-    memcpy(arr + il, g, ig * 4); // Copy array of significant digit 1's to the main array after the significant digit 0's
+    else
+    {
+      bits[i] ^= (bits[i] >> 63) ? 0x8000000000000000ull : 0xFFFFFFFFFFFFFFFFull;
+    }
+  }
+}
+
+/**
+ * Sorts keys of width bytes on several threads, a byte at a time like
+ * radix_sort32. In each pass every thread counts the digits of its slice,
+ * a prefix sum over all the histograms, bucket by bucket and thread by
+ * thread, gives every thread the positions its keys go to, and the threads
+ * scatter their slices at once. Equal digits keep their order, so the
+ * result is the same as the serial sort's.
+ * Returns 1 if successful, 0 if memory allocation fails.
+ */
+int parallel_radix_sort(void *keys, long size, int width, int is_signed, int threads)
+{
+  Slice *slices;
+  void *src = keys, *dst, *temp;
+  long total;
+  int t, b, d;
 
-    sig_digit *= 2; // Move to the next significant digit in the binary number
-    ig = il = 0;    // Reset recipient array counters to 0
+  if (size < (long)threads * 256) // Not worth splitting
+  {
+    return width == 4 ? radix_sort32((uint32_t *)keys, size, is_signed) : radix_sort64((uint64_t *)keys, size, is_signed);
+  }
+
+  slices = (Slice *)calloc(threads, sizeof(Slice));
+  dst = malloc((size_t)width * size);
+  if (slices == NULL || dst == NULL)
+  {
+    free(slices);
+    free(dst);
+    return 0;
   }
 
-  // Free the memory allocated for the arrays
-  free(g);
-  free(l);
+  for (d = 0; d < width; d++) // One pass per byte, least significant first
+  {
+    for (t = 0; t < threads; t++)
+    {
+      slices[t].src = src;
+      slices[t].dst = dst;
+      slices[t].lo = size * t / threads;
+      slices[t].hi = size * (t + 1) / threads;
+      slices[t].width = width;
+      slices[t].shift = 8 * d;
+      slices[t].flip = is_signed && d == width - 1 ? 0x80 : 0;
+    }
+    run_threads(histogram_digits, slices, sizeof(Slice), threads);
+
+    // Skip the byte if it is the same in every key
+    b = width == 4 ? DIGIT_AT(&slices[0], uint32_t, 0) : DIGIT_AT(&slices[0], uint64_t, 0);
+    for (t = 0, total = 0; t < threads; t++)
+    {
+      total += slices[t].count[b];
+    }
+    if (total == size)
+    {
+      continue;
+    }
+
+    offset_slices(slices[0].count, sizeof(Slice), threads, 256, NULL);
+    run_threads(scatter_digits, slices, sizeof(Slice), threads);
+
+    temp = src;
+    src = dst;
+    dst = temp;
+  }
+
+  finish_passes(keys, src, dst, (size_t)width * size);
+  free(slices);
 
   return 1;
 }
+
+/**
+ * Ends a sort whose passes swap the keys between their array and a
+ * scratch buffer: after an odd number of passes the result is in the
+ * scratch buffer, so it is copied back first. src holds the result, dst
+ * the other buffer, and bytes is the size of either; the scratch buffer
+ * is freed.
+ */
+void finish_passes(void *keys, void *src, void *dst, size_t bytes)
+{
+  if (src != keys)
+  {
+    memcpy(keys, src, bytes);
+    dst = src;
+  }
+  free(dst);
+}
+
+void *histogram_digits(void *arg)
+{
+  Slice *s = (Slice *)arg;
+  long i;
+
+  memset(s->count, 0, sizeof(s->count));
+  for (i = s->lo; i < s->hi; i++)
+  {
+    s->count[s->width == 4 ? DIGIT_AT(s, uint32_t, i) : DIGIT_AT(s, uint64_t, i)]++;
+  }
+  return NULL;
+}
+
+// Scatters the keys of a slice through a write-combining buffer per bucket:
+// keys are gathered in a cache line's worth of stack memory and copied out
+// at once. The first copy to each bucket only goes as far as the next line
+// boundary of the destination, so every copy after it writes one whole,
+// aligned line instead of parts of two
+#define SCATTER_COMBINED(s, type)                                                \
+  do                                                                             \
+  {                                                                              \
+    type lines[256][COMBINE_BYTES / sizeof(type)], *dst = (type *)(s)->dst;      \
+    int fill[256] = {0}, room[256], b;                                           \
+    long i;                                                                      \
+    for (b = 0; b < 256; b++) /* Keys up to the bucket's next line boundary */   \
+    {                                                                            \
+      room[b] = COMBINE_BYTES / sizeof(type) -                                   \
+                (uintptr_t)(dst + (s)->count[b]) % COMBINE_BYTES / sizeof(type); \
+    }                                                                            \
+    for (i = (s)->lo; i < (s)->hi; i++)                                          \
+    {                                                                            \
+      b = DIGIT_AT(s, type, i);                                                  \
+      lines[b][fill[b]++] = ((const type *)(s)->src)[i];                         \
+      if (fill[b] == room[b])                                                    \
+      {                                                                          \
+        memcpy(dst + (s)->count[b], lines[b], sizeof(type) * fill[b]);           \
+        (s)->count[b] += fill[b];                                                \
+        fill[b] = 0;                                                             \
+        room[b] = COMBINE_BYTES / sizeof(type);                                  \
+      }                                                                          \
+    }                                                                            \
+    for (b = 0; b < 256; b++) /* Write out what is left of every line */        \
+    {                                                                            \
+      memcpy(dst + (s)->count[b], lines[b], sizeof(type) * fill[b]);             \
+      (s)->count[b] += fill[b];                                                  \
+    }                                                                            \
+  } while (0)
+
+void *scatter_digits(void *arg)
+{
+  Slice *s = (Slice *)arg;
+
+  if (s->width == 4)
+  {
+    SCATTER_COMBINED(s, uint32_t);
+  }
+  else
+  {
+    SCATTER_COMBINED(s, uint64_t);
+  }
+  return NULL;
+}
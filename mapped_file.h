@@ -0,0 +1,76 @@
+/**
+ * Maps whole files into memory for the sorters that read their input in
+ * place: the numbers of the integer sorters and the words of
+ * lsd-radix-sort-strings are parsed and sorted where they are mapped,
+ * without a copy into the heap.
+ */
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * Maps the whole file at path, advised to be read from start to end. With
+ * writable set the mapping is private copy-on-write, so writes to it never
+ * reach the file.
+ * Returns NULL on failure with size set to -1; an empty file gives an
+ * allocation of one byte and size 0.
+ */
+static inline char *map_file(const char *path, long *size, int writable)
+{
+  struct stat st;
+  char *data;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) < 0)
+  {
+    printf("Error opening file.\n");
+    if (fd >= 0)
+    {
+      close(fd);
+    }
+    *size = -1;
+    return NULL;
+  }
+
+  *size = st.st_size;
+  if (*size == 0) // An empty file cannot be mapped
+  {
+    close(fd);
+    return (char *)malloc(1);
+  }
+
+  data = (char *)mmap(NULL, *size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // The mapping stays valid after the descriptor is closed
+  if (data == MAP_FAILED)
+  {
+    printf("Error opening file.\n");
+    *size = -1;
+    return NULL;
+  }
+  madvise(data, *size, MADV_SEQUENTIAL);
+  return data;
+}
+
+/**
+ * Unmaps a file from map_file.
+ */
+static inline void unmap_file(char *data, long size)
+{
+  if (size > 0)
+  {
+    munmap(data, size);
+  }
+  else
+  {
+    free(data);
+  }
+}
+
+#endif
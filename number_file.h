@@ -0,0 +1,417 @@
+/**
+ * Reads and writes files of numbers for the integer sorters, so they are
+ * not limited to what fits on the command line. A file is either text,
+ * one number per line (LF or CRLF, empty lines skipped) and integers also
+ * separated by spaces, or binary: the raw numbers one after another,
+ * little-endian, with no separators. Both sorters read and write through
+ * read_numbers and write_numbers, so they take the same files and fail on
+ * them with the same codes.
+ *
+ * Binary files are memory-mapped copy-on-write, so the numbers are sorted
+ * where they are mapped without a copy into the heap and without changing
+ * the file. Text files are mapped read-only; integers are parsed in bulk,
+ * floating point numbers a line at a time.
+ */
+#ifndef NUMBER_FILE_H
+#define NUMBER_FILE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <math.h> // For HUGE_VAL
+#include "mapped_file.h"
+#include "int_parser.h"
+
+#define NUMBER_TOKEN_MAX 64 // Longest line a number can be written on
+
+// Types of numbers a file can hold
+#define INT32 0
+#define INT64 1
+#define UINT64 2
+#define FLOAT 3
+#define DOUBLE 4
+
+static const char *const number_type_names[] = {"int32", "int64", "uint64", "float", "double"};
+
+/**
+ * Returns the number of bytes in a number of the type.
+ */
+static inline int number_width(int type)
+{
+  return type == INT32 || type == FLOAT ? 4 : 8;
+}
+
+/**
+ * Reads the option at argv[*first] for the integer sorters. Options are
+ * parsed by hand, as negative numbers look like options to getopt: an
+ * option is a dash and one of the letters in options, and those also in
+ * valued take the next argument as their value.
+ * Returns the letter with *first moved past the option and value set to
+ * its value, 0 once the arguments no longer start with an option, or '?'
+ * if the option at argv[*first] is missing its value.
+ */
+static inline int next_number_option(int argc, char **argv, int *first, const char *options, const char *valued,
+                                     const char **value)
+{
+  const char *arg = *first < argc ? argv[*first] : "";
+
+  if (arg[0] != '-' || arg[1] == '\0' || arg[2] != '\0' || strchr(options, arg[1]) == NULL)
+  {
+    return 0;
+  }
+  if (strchr(valued, arg[1]) != NULL)
+  {
+    if (*first + 1 == argc)
+    {
+      return '?';
+    }
+    *value = argv[++*first];
+  }
+  ++*first;
+  return arg[1];
+}
+
+/**
+ * Swaps the bytes of count numbers of width bytes between little-endian
+ * and the order of this machine; nothing to do on little-endian machines.
+ */
+static inline void swap_number_bytes(void *numbers, long count, int width)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  long i;
+
+  for (i = 0; i < count; i++)
+  {
+    if (width == 4)
+    {
+      ((uint32_t *)numbers)[i] = __builtin_bswap32(((uint32_t *)numbers)[i]);
+    }
+    else
+    {
+      ((uint64_t *)numbers)[i] = __builtin_bswap64(((uint64_t *)numbers)[i]);
+    }
+  }
+#else
+  (void)numbers;
+  (void)count;
+  (void)width;
+#endif
+}
+
+/**
+ * Copies the next line of a text file that is not empty into token as a
+ * null-terminated string, and moves pos past it. line is moved on by each
+ * line passed over, so starting it at 0 leaves it at the line number of
+ * the token.
+ * Returns the length of the line, -1 once there are no more lines, or
+ * NUMBER_TOKEN_MAX if the line is too long to be a number.
+ */
+static inline long next_number_token(const char *text, long size, long *pos, long *line, char *token)
+{
+  const char *end;
+  long len;
+
+  while (*pos < size)
+  {
+    ++*line;
+    end = (const char *)memchr(text + *pos, '\n', size - *pos);
+    len = (end ? end - text : size) - *pos;
+    if (len > 0 && text[*pos + len - 1] == '\r')
+    {
+      len--;
+    }
+
+    if (len >= NUMBER_TOKEN_MAX)
+    {
+      return NUMBER_TOKEN_MAX;
+    }
+    memcpy(token, text + *pos, len);
+    token[len] = '\0';
+    *pos = end ? end - text + 1 : size;
+
+    if (len > 0)
+    {
+      return len;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Counts the numbers in a text file: one per line that is not empty.
+ */
+static inline long count_number_lines(const char *text, long size)
+{
+  const char *end;
+  long pos = 0, len, count = 0;
+
+  while (pos < size)
+  {
+    end = (const char *)memchr(text + pos, '\n', size - pos);
+    len = (end ? end - text : size) - pos;
+    if (len > 0 && text[pos + len - 1] == '\r')
+    {
+      len--;
+    }
+    count += len > 0;
+    pos = end ? end - text + 1 : size;
+  }
+  return count;
+}
+
+/**
+ * Opens the file at path for writing the sorted numbers, or standard
+ * output if path is NULL, with a large buffer.
+ * Returns NULL if the file cannot be opened.
+ */
+static inline FILE *open_number_output(const char *path)
+{
+  FILE *fp = path ? fopen(path, "wb") : stdout;
+
+  if (fp == NULL)
+  {
+    printf("Error opening output file.\n");
+    return NULL;
+  }
+  setvbuf(fp, NULL, _IOFBF, 1 << 22);
+  return fp;
+}
+
+/**
+ * Finishes writing to a file from open_number_output.
+ * Returns 0 if everything was written, 1 otherwise.
+ */
+static inline int close_number_output(FILE *fp)
+{
+  int res = ferror(fp);
+
+  res |= fp == stdout ? fflush(fp) : fclose(fp);
+  if (res)
+  {
+    printf("Error writing output file.\n");
+  }
+  return res != 0;
+}
+
+/**
+ * Converts a string to a number of the type and stores it at index i of
+ * arr. The whole string must be the number, and it must fit in the type.
+ * Returns 1 if successful, 0 otherwise.
+ */
+static inline int parse_number(const char *str, int type, void *arr, long i)
+{
+  char *end;
+  int64_t value = 0;
+
+  errno = 0;
+  switch (type)
+  {
+  case INT32:
+    if (!parse_int(str, strlen(str), &value) || value < INT32_MIN || value > INT32_MAX)
+    {
+      return 0;
+    }
+    ((int32_t *)arr)[i] = (int32_t)value;
+    return 1;
+  case INT64:
+    return parse_int(str, strlen(str), &((int64_t *)arr)[i]);
+  case UINT64:
+    return parse_uint(str, strlen(str), &((uint64_t *)arr)[i]);
+  case FLOAT:
+    ((float *)arr)[i] = strtof(str, &end);
+    if (((float *)arr)[i] > -HUGE_VALF && ((float *)arr)[i] < HUGE_VALF) // Only overflow is an error, not tiny numbers
+    {
+      errno = 0;
+    }
+    break;
+  default:
+    ((double *)arr)[i] = strtod(str, &end);
+    if (((double *)arr)[i] > -HUGE_VAL && ((double *)arr)[i] < HUGE_VAL)
+    {
+      errno = 0;
+    }
+  }
+
+  return end != str && *end == '\0' && errno != ERANGE;
+}
+
+/**
+ * Prints the number at index i of arr to fp, with every digit needed to
+ * read it back for floating point types.
+ */
+static inline void print_number(FILE *fp, const void *arr, int type, long i)
+{
+  switch (type)
+  {
+  case INT32:
+    fprintf(fp, "%d", (int)((const int32_t *)arr)[i]);
+    break;
+  case INT64:
+    fprintf(fp, "%lld", (long long)((const int64_t *)arr)[i]);
+    break;
+  case UINT64:
+    fprintf(fp, "%llu", (unsigned long long)((const uint64_t *)arr)[i]);
+    break;
+  case FLOAT:
+    fprintf(fp, "%.9g", ((const float *)arr)[i]);
+    break;
+  default:
+    fprintf(fp, "%.17g", ((const double *)arr)[i]);
+  }
+}
+
+/**
+ * Reads the integers of a text file with the bulk parser, into an array of
+ * the type.
+ * Returns the array, or NULL with count set to -2 if memory allocation
+ * fails and -3 if the text holds something that is not an integer of the
+ * type.
+ */
+static inline void *read_integers(const char *text, long size, int type, long *count)
+{
+  int64_t *values;
+  long i, bad;
+
+  *count = parse_int_tokens(text, size, NULL, 0, &bad);
+  values = (int64_t *)malloc(sizeof(int64_t) * (*count + 1));
+  if (values == NULL)
+  {
+    printf("Memory allocation failed.\n");
+    *count = -2;
+    return NULL;
+  }
+
+  if (parse_int_tokens(text, size, values, type == UINT64, &bad) < 0)
+  {
+    report_bad_int(text, size, bad);
+    free(values);
+    *count = -3;
+    return NULL;
+  }
+
+  // int32 numbers are narrowed in place; each one is written below where the next is read
+  for (i = 0; type == INT32 && i < *count; i++)
+  {
+    if (values[i] < INT32_MIN || values[i] > INT32_MAX)
+    {
+      printf("Please use only numbers; %lld is not a valid int32.\n", (long long)values[i]);
+      free(values);
+      *count = -3;
+      return NULL;
+    }
+    ((int32_t *)values)[i] = (int32_t)values[i];
+  }
+  return values;
+}
+
+/**
+ * Reads the numbers of a file. A binary file is mapped copy-on-write and
+ * its numbers are used where they are, with mapped set to the size of the
+ * mapping; a text file is parsed into a new array, with mapped set to -1.
+ * Returns the numbers, or NULL with count set to -1 if the file cannot be
+ * opened, -2 if memory allocation fails, -3 if a line is not a number of
+ * the type and -4 if a binary file does not hold whole numbers.
+ */
+static inline void *read_numbers(const char *path, int type, int binary, long *count, long *mapped)
+{
+  char *data, token[NUMBER_TOKEN_MAX];
+  void *arr;
+  long size, pos = 0, line = 0, len, i;
+  int width = number_width(type);
+
+  data = map_file(path, &size, binary);
+  if (data == NULL)
+  {
+    *count = -1;
+    return NULL;
+  }
+
+  if (binary)
+  {
+    if (size % width != 0)
+    {
+      printf("The file holds %ld bytes, which is not a whole number of %d-byte numbers.\n", size, width);
+      unmap_file(data, size);
+      *count = -4;
+      return NULL;
+    }
+    *count = size / width;
+    *mapped = size;
+    swap_number_bytes(data, *count, width);
+    return data;
+  }
+
+  if (type == INT32 || type == INT64 || type == UINT64)
+  {
+    arr = read_integers(data, size, type, count);
+    unmap_file(data, size);
+    *mapped = -1;
+    return arr;
+  }
+
+  *count = count_number_lines(data, size);
+  arr = malloc((size_t)width * (*count + 1));
+  if (arr == NULL)
+  {
+    printf("Memory allocation failed.\n");
+    unmap_file(data, size);
+    *count = -2;
+    return NULL;
+  }
+
+  for (i = 0; (len = next_number_token(data, size, &pos, &line, token)) >= 0; i++)
+  {
+    if (len == NUMBER_TOKEN_MAX || !parse_number(token, type, arr, i))
+    {
+      printf("Please use only numbers; line %ld is not a valid %s.\n", line, number_type_names[type]);
+      unmap_file(data, size);
+      free(arr);
+      *count = -3;
+      return NULL;
+    }
+  }
+
+  unmap_file(data, size);
+  *mapped = -1;
+  return arr;
+}
+
+/**
+ * Writes the sorted numbers to the file at path, or standard output if
+ * path is NULL: raw and little-endian if binary is set, otherwise one per
+ * line.
+ * Returns 0 if successful, 1 if the file cannot be opened or written.
+ */
+static inline int write_numbers(const char *path, void *arr, long count, int type, int binary)
+{
+  FILE *fp = open_number_output(path);
+  int width = number_width(type);
+  long i;
+
+  if (fp == NULL)
+  {
+    return 1;
+  }
+
+  if (binary)
+  {
+    swap_number_bytes(arr, count, width);
+    fwrite(arr, width, count, fp);
+  }
+  else
+  {
+    for (i = 0; i < count; i++)
+    {
+      print_number(fp, arr, type, i);
+      putc('\n', fp);
+    }
+  }
+
+  return close_number_output(fp);
+}
+
+#endif
@@ -0,0 +1,75 @@
+/**
+ * Runs the passes of the parallel radix sorts, which cut their array into
+ * one slice per thread: each thread counts the digits of its slice, and
+ * once the counts are turned into positions the threads scatter their
+ * slices at once. The slices are an array of structs, one per thread, and
+ * both helpers step through it by the size of one.
+ */
+#ifndef SLICE_THREADS_H
+#define SLICE_THREADS_H
+
+#include <stdlib.h>
+#include <pthread.h>
+
+/**
+ * Runs fn on n threads; thread t gets args + t * size as its argument.
+ * If a thread cannot be started, its work runs on the calling thread.
+ */
+static inline void run_threads(void *(*fn)(void *), void *args, size_t size, int n)
+{
+  pthread_t *ids = (pthread_t *)malloc(sizeof(pthread_t) * n);
+  char *started = (char *)calloc(n, sizeof(char));
+  int t;
+
+  for (t = 0; t < n; t++)
+  {
+    if (ids != NULL && started != NULL && pthread_create(&ids[t], NULL, fn, (char *)args + t * size) == 0)
+    {
+      started[t] = 1;
+    }
+    else
+    {
+      fn((char *)args + t * size);
+    }
+  }
+  for (t = 0; t < n; t++)
+  {
+    if (started != NULL && started[t])
+    {
+      pthread_join(ids[t], NULL);
+    }
+  }
+
+  free(ids);
+  free(started);
+}
+
+/**
+ * Turns the histograms of n slices into where each slice writes the first
+ * key of each of the buckets. count is the histogram of the first slice,
+ * and the next slice's is size bytes further on. Bucket by bucket, each
+ * slice writes after the slices before it, so equal digits keep their
+ * order. If start is not NULL, it gets where each bucket begins.
+ */
+static inline void offset_slices(long *count, size_t size, int n, int buckets, long *start)
+{
+  long total = 0, c, *slice;
+  int t, b;
+
+  for (b = 0; b < buckets; b++)
+  {
+    if (start != NULL)
+    {
+      start[b] = total;
+    }
+    for (t = 0; t < n; t++)
+    {
+      slice = (long *)((char *)count + t * size);
+      c = slice[b];
+      slice[b] = total;
+      total += c;
+    }
+  }
+}
+
+#endif
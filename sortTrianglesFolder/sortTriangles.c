@@ -62,6 +62,7 @@ void mergeSort(struct Triangle arr[], int left, int right) {
     }
 }
 
+#ifndef SORT_BENCHMARK
 int main() {
     int n;
     printf("Enter the number of triangles: ");
@@ -86,3 +87,4 @@ int main() {
 
     return 0;
 }
+#endif
@@ -0,0 +1,309 @@
+/**
+ * Splits a buffer of newline-separated words into views, for the string
+ * sorters. Lines may end in LF or CRLF, the last line does not need a line
+ * ending, and empty lines are skipped. Words may only contain letters and
+ * numbers, unless the caller allows any bytes. load_arena then packs the
+ * words of a file into one slab. scan_lines tokenizes part of a buffer, so
+ * callers can split a large one between threads.
+ *
+ * On x86 the buffer is scanned 32 bytes at a time with AVX2 (when compiled
+ * with -mavx2 or -march=native) or 16 bytes at a time with SSE2, finding
+ * line endings and checking the characters with vector compares. Other
+ * machines use the scalar loop, which the vector loops also use for the
+ * last few bytes.
+ */
+#ifndef WORD_TOKENIZER_H
+#define WORD_TOKENIZER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TOKENIZER_WIDTH 32
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define TOKENIZER_WIDTH 16
+#endif
+
+/**
+ * A word is a view into the file contents: where it starts and how many
+ * characters it has. Sorting moves these views, never the characters.
+ */
+typedef struct
+{
+  long off; // Offset of the first character in the text
+  long len; // Number of characters, without the line ending
+} Word;
+
+/**
+ * All the words of a file in one block of memory. The slab holds the words
+ * one after another, each followed by a null character, and words says
+ * where each one is. Freeing the arena is two calls to free, however many
+ * words it holds.
+ */
+typedef struct
+{
+  char *slab;
+  Word *words;
+  long word_count;
+} WordArena;
+
+#ifdef TOKENIZER_WIDTH
+/**
+ * Classifies one block of the buffer. Bit i of the masks stands for byte i.
+ * Returns the mask of bytes that are neither letters, numbers nor part of a
+ * line ending, and sets the masks of newlines and carriage returns.
+ */
+static inline unsigned int classify_block(const char *p, unsigned int *newlines, unsigned int *returns)
+{
+#if TOKENIZER_WIDTH == 32
+  __m256i c = _mm256_loadu_si256((const __m256i *)p);
+  __m256i lower = _mm256_or_si256(c, _mm256_set1_epi8(0x20)); // Folds upper case into lower case
+  __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)),
+                                   _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c));
+  __m256i letter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                    _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+  __m256i nl = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\n'));
+  __m256i cr = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\r'));
+
+  *newlines = (unsigned int)_mm256_movemask_epi8(nl);
+  *returns = (unsigned int)_mm256_movemask_epi8(cr);
+  return ~(unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(digit, letter), _mm256_or_si256(nl, cr)));
+#else
+  __m128i c = _mm_loadu_si128((const __m128i *)p);
+  __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20)); // Folds upper case into lower case
+  __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+                                _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+  __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                 _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+  __m128i nl = _mm_cmpeq_epi8(c, _mm_set1_epi8('\n'));
+  __m128i cr = _mm_cmpeq_epi8(c, _mm_set1_epi8('\r'));
+
+  *newlines = (unsigned int)_mm_movemask_epi8(nl);
+  *returns = (unsigned int)_mm_movemask_epi8(cr);
+  return ~(unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(digit, letter), _mm_or_si128(nl, cr))) & 0xFFFF;
+#endif
+}
+#endif
+
+/**
+ * Prints why the byte at position i is not allowed.
+ * Returns 5, the file format error code of the sorters.
+ */
+static inline int report_bad_byte(const char *buffer, long i)
+{
+  if (buffer[i] == ' ')
+  {
+    printf("Please format the file to contain words only separated by newlines (byte %ld).\n", i);
+  }
+  else if (buffer[i] == '\r')
+  {
+    printf("Please only use carriage returns right before newlines (byte %ld).\n", i);
+  }
+  else
+  {
+    printf("Please use only numbers and letters in the words (byte %ld).\n", i);
+  }
+  return 5;
+}
+
+/**
+ * Adds the line from start to end (the position of its newline) to the
+ * views, leaving out a carriage return before the newline and skipping
+ * empty lines. If *words is NULL the line is only counted.
+ * Returns 0 if successful, 4 if memory allocation fails.
+ */
+static inline int add_line(const char *buffer, long start, long end, Word **words, long *word_count, long *capacity)
+{
+  Word *grown;
+
+  if (end > start && buffer[end - 1] == '\r')
+  {
+    end--;
+  }
+  if (end == start)
+  {
+    return 0;
+  }
+  if (*words == NULL)
+  {
+    (*word_count)++;
+    return 0;
+  }
+
+  if (*word_count == *capacity)
+  {
+    *capacity *= 2;
+    grown = (Word *)realloc(*words, sizeof(Word) * *capacity);
+    if (grown == NULL)
+    {
+      printf("Memory allocation failed.\n");
+      return 4;
+    }
+    *words = grown;
+  }
+
+  (*words)[*word_count].off = start;
+  (*words)[*word_count].len = end - start;
+  (*word_count)++;
+  return 0;
+}
+
+/**
+ * Tokenizes the lines of buffer from lo to hi, adding them to words, which
+ * grows as needed from capacity. lo must be the start of a line and hi the
+ * end of the buffer or just past a newline; size is the length of the
+ * whole buffer. With any_bytes set, only line endings are special and
+ * words may hold any other byte. If *words is NULL the words are only
+ * counted.
+ * Returns 0 if successful, 4 if memory allocation fails and 5 if the
+ * lines hold anything other than words and line endings, with the
+ * position of the first bad byte in bad.
+ */
+static inline int scan_lines(const char *buffer, long lo, long hi, long size, int any_bytes,
+                             Word **words, long *word_count, long *capacity, long *bad_byte)
+{
+  long i = lo,    // Position in the buffer
+      line = lo; // Start of the current line
+  int res = 0;
+
+#ifdef TOKENIZER_WIDTH
+  unsigned int bad, newlines, returns, next_newline;
+
+  for (; i + TOKENIZER_WIDTH <= hi && res == 0; i += TOKENIZER_WIDTH)
+  {
+    bad = classify_block(buffer + i, &newlines, &returns);
+
+    // A carriage return is only allowed right before a newline or at the end
+    next_newline = i + TOKENIZER_WIDTH == size || buffer[i + TOKENIZER_WIDTH] == '\n';
+    bad |= returns & ~((newlines >> 1) | (next_newline << (TOKENIZER_WIDTH - 1)));
+    if (bad && !any_bytes)
+    {
+      *bad_byte = i + __builtin_ctz(bad);
+      return 5;
+    }
+
+    for (; newlines && res == 0; newlines &= newlines - 1) // One newline at a time
+    {
+      res = add_line(buffer, line, i + __builtin_ctz(newlines), words, word_count, capacity);
+      line = i + __builtin_ctz(newlines) + 1;
+    }
+  }
+#endif
+
+  for (; i < hi && res == 0; i++)
+  {
+    if (buffer[i] == '\n')
+    {
+      res = add_line(buffer, line, i, words, word_count, capacity);
+      line = i + 1;
+    }
+    else if (!any_bytes &&
+             !((buffer[i] >= '0' && buffer[i] <= '9') || ((buffer[i] | 0x20) >= 'a' && (buffer[i] | 0x20) <= 'z')) &&
+             !(buffer[i] == '\r' && (i + 1 == size || buffer[i + 1] == '\n')))
+    {
+      *bad_byte = i;
+      return 5;
+    }
+  }
+
+  if (res == 0) // The last line may not have a newline
+  {
+    res = add_line(buffer, line, hi, words, word_count, capacity);
+  }
+  return res;
+}
+
+/**
+ * Builds the array of views for the words in buffer in a single pass.
+ * With any_bytes set, only line endings are special and words may hold
+ * any other byte.
+ * Returns 0 if successful, 4 if memory allocation fails and 5 if the
+ * buffer holds anything other than words and line endings. On failure
+ * words is freed.
+ */
+static inline int tokenize_words(const char *buffer, long size, int any_bytes, Word **words, long *word_count)
+{
+  long capacity = size / 16 + 16, // Room in words; doubles when full
+      bad;                        // Position of a byte that is not allowed
+  int res;
+
+  *word_count = 0;
+  *words = (Word *)malloc(sizeof(Word) * capacity);
+  if (*words == NULL)
+  {
+    printf("Memory allocation failed.\n");
+    return 4;
+  }
+
+  res = scan_lines(buffer, 0, size, size, any_bytes, words, word_count, &capacity, &bad);
+  if (res == 5)
+  {
+    report_bad_byte(buffer, bad);
+  }
+
+  if (res)
+  {
+    free(*words);
+    *words = NULL;
+  }
+  return res;
+}
+
+/**
+ * Fills the arena from a buffer of file contents, which the arena takes
+ * over: the words are tokenized, then moved down over their line endings
+ * so they sit back to back, null-terminated, and the slab is shrunk to
+ * fit. The buffer must have room for one byte past size. any_bytes is
+ * passed on to tokenize_words.
+ * Returns 0 if successful, or the tokenizer's return code; on failure the
+ * buffer is freed.
+ */
+static inline int load_arena(WordArena *arena, char *buffer, long size, int any_bytes)
+{
+  long used = 0; // Bytes of the slab filled so far
+  char *shrunk;
+  long i;
+  int res;
+
+  arena->slab = buffer;
+  res = tokenize_words(buffer, size, any_bytes, &arena->words, &arena->word_count);
+  if (res)
+  {
+    free(buffer);
+    arena->slab = NULL;
+    return res;
+  }
+
+  // Each word had at least one line ending byte after it, so it only moves down
+  for (i = 0; i < arena->word_count; i++)
+  {
+    memmove(buffer + used, buffer + arena->words[i].off, arena->words[i].len);
+    arena->words[i].off = used;
+    used += arena->words[i].len;
+    buffer[used++] = '\0';
+  }
+
+  shrunk = (char *)realloc(buffer, used + 1);
+  if (shrunk != NULL)
+  {
+    arena->slab = shrunk;
+  }
+  return 0;
+}
+
+/**
+ * Frees everything the arena holds.
+ */
+static inline void free_arena(WordArena *arena)
+{
+  free(arena->slab);
+  free(arena->words);
+  arena->slab = NULL;
+  arena->words = NULL;
+  arena->word_count = 0;
+}
+
+#endif